@@ -9,6 +9,7 @@
 #include "vm.h"
 #include "fb.h"
 #include "animation.h"
+#include "trace.h"
 
 // Animation state
 static int x = 0;
@@ -67,6 +68,7 @@ draw_next_frame(void)
     // Called from timer interrupt context (interrupts disabled)
     erase_previous();
     fb_draw_rect(x, y, w, h, 0xff2020);  // red rectangle
+    trace_record(TR_FRAME, frame_no, 0);
     fb_print_ascii_if_needed();
 }
 
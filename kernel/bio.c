@@ -22,6 +22,7 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "iostat.h"
 
 struct {
   struct spinlock lock;
@@ -33,6 +34,12 @@ struct {
   struct buf head;
 } bcache;
 
+// Block I/O statistics.  Each group of fields is written under the
+// lock of the code that owns it: the bcache fields under bcache.lock,
+// the disk fields under the virtio disk lock, the log fields by the
+// single committer in log.c.
+struct iostat iostats;
+
 void
 binit(void)
 {
@@ -66,6 +73,7 @@ bget(uint dev, uint blockno)
   for(b = bcache.head.next; b != &bcache.head; b = b->next){
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
+      iostats.bhits++;
       release(&bcache.lock);
       acquiresleep(&b->lock);
       return b;
@@ -76,6 +84,9 @@ bget(uint dev, uint blockno)
   // Recycle the least recently used (LRU) unused buffer.
   for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
     if(b->refcnt == 0) {
+      iostats.bmisses++;
+      if(b->valid)
+        iostats.bevicts++;
       b->dev = dev;
       b->blockno = blockno;
       b->valid = 0;
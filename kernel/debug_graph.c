@@ -1,67 +1,45 @@
 // kernel/debug_graph.c
 #include "types.h"
-#include "defs.h"
+#include "param.h"
+#include "riscv.h"
 #include "spinlock.h"
+#include "defs.h"
+#include "trace.h"
 #include "debug_graph.h"
 
 /*
- * Simple circular sampler + ASCII dumper for kernel debug/profiling.
+ * ASCII dumper for kernel debug/profiling samples.
+ *
+ * Samples live in the per-hart trace rings (trace.c) as TR_DBG
+ * events, so recording is lock-free; only the dump path, which
+ * needs a scratch buffer, takes a lock.
  */
 
-struct dbg_sample {
-  uint64 when;   // time tick when recorded (if available)
-  int value;     // recorded metric
-};
-
-static struct dbg_sample samples[DBG_SAMPLES];
-static int head = 0;        // next write index (circular)
-static int count = 0;       // number of valid samples (<= DBG_SAMPLES)
-static struct spinlock dbg_lock;
+static struct trace_event samples[DBG_SAMPLES];
+static struct spinlock dbg_lock;    // protects samples[] while dumping
+static uint64 dbg_since;            // dump ignores samples before this time
 static int dbg_inited = 0;
 
-extern uint ticks; // defined in trap.c
-
 void
 dbg_init(void)
 {
   if(dbg_inited) return;
   initlock(&dbg_lock, "dbg_graph");
-  acquire(&dbg_lock);
-  head = 0;
-  count = 0;
-  for(int i = 0; i < DBG_SAMPLES; i++){
-    samples[i].when = 0;
-    samples[i].value = 0;
-  }
+  dbg_since = 0;
   dbg_inited = 1;
-  release(&dbg_lock);
 }
 
 void
 dbg_clear(void)
 {
-  acquire(&dbg_lock);
-  head = 0;
-  count = 0;
-  for(int i = 0; i < DBG_SAMPLES; i++){
-    samples[i].when = 0;
-    samples[i].value = 0;
-  }
-  release(&dbg_lock);
+  dbg_since = r_time();
 }
 
 /* Cheap recorder used in timer context */
 void
 dbg_record(int value)
 {
-  if(!dbg_inited) dbg_init();
-
-  acquire(&dbg_lock);
-  samples[head].value = value;
-  samples[head].when = ticks; // use kernel ticks if available
-  head = (head + 1) % DBG_SAMPLES;
-  if(count < DBG_SAMPLES) count++;
-  release(&dbg_lock);
+  trace_record(TR_DBG, value, 0);
 }
 
 /* Print collected samples as a simple ASCII graph. */
@@ -72,6 +50,21 @@ dbg_dump_ascii(void)
 
   acquire(&dbg_lock);
 
+  int n = trace_snapshot(TR_DBG, samples, DBG_SAMPLES);
+
+  // keep samples newer than the last dbg_clear(), oldest first.
+  int count = 0;
+  for(int i = 0; i < n; i++)
+    if(samples[i].ts > dbg_since)
+      samples[count++] = samples[i];
+  for(int i = 1; i < count; i++){
+    struct trace_event e = samples[i];
+    int j = i;
+    for(; j > 0 && samples[j-1].ts > e.ts; j--)
+      samples[j] = samples[j-1];
+    samples[j] = e;
+  }
+
   if(count == 0){
     printf("[dbg] no samples\n");
     release(&dbg_lock);
@@ -79,32 +72,26 @@ dbg_dump_ascii(void)
   }
 
   int maxv = 1;
-  int idx_start = (head - count + DBG_SAMPLES) % DBG_SAMPLES;
   for(int i = 0; i < count; i++){
-    int idx = (idx_start + i) % DBG_SAMPLES;
-    int v = samples[idx].value;
+    int v = (int)samples[i].arg0;
     if(v > maxv) maxv = v;
   }
 
   printf("[dbg] samples=%d max=%d\n", count, maxv);
   for(int i = 0; i < count; i++){
-    int idx = (idx_start + i) % DBG_SAMPLES;
-    int v = samples[idx].value;
+    int v = (int)samples[i].arg0;
     int len = (v * DBG_ASCII_WIDTH) / maxv;
     if(len < 0) len = 0;
     if(len > DBG_ASCII_WIDTH) len = DBG_ASCII_WIDTH;
 
-    if(samples[idx].when)
-      printf("%5d: %4d |", (int)samples[idx].when, v);
-    else
-      printf("       %4d |", v);
-
+    char bar[DBG_ASCII_WIDTH + 1];
     for (int b = 0; b < len; b++)
-    consputc('*');
-consputc('\n');
+      bar[b] = '*';
+    bar[len] = 0;
 
+    // timestamps in ms since the first sample shown
+    printf("%5d: %4d |%s\n", (int)((samples[i].ts - samples[0].ts) / 10000), v, bar);
   }
 
   release(&dbg_lock);
 }
-
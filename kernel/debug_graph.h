@@ -14,16 +14,16 @@
  *   dbg_dump_ascii();           // prints ASCII graph to kernel console (printf)
  *   dbg_clear();                // clear buffer
  *
- * Thread-safety: protected by internal spinlock.
+ * Thread-safety: samples are TR_DBG events in the per-hart trace
+ * rings (see trace.c), so dbg_record() takes no lock.
  */
 
-#define DBG_SAMPLES 128     // number of samples in circular buffer
+#define DBG_SAMPLES 128     // max samples shown by dbg_dump_ascii()
 #define DBG_ASCII_WIDTH 60  // max width of ASCII bar when dumping
 
 void dbg_init(void);
 void dbg_record(int value);    // record a sample (value can be any small int)
 void dbg_dump_ascii(void);     // pretty-print collected samples to kernel console
-void dbg_clear(void);          // reset buffer
+void dbg_clear(void);          // forget samples recorded so far
 
 #endif // DEBUG_GRAPH_H
-
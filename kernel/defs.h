@@ -12,6 +12,11 @@ struct sleeplock;
 struct stat;
 struct superblock;
 struct cpu;
+struct trace_event;
+struct memstat;
+struct iostat;
+struct perfcount;
+struct hrtimer;
 
 #include "param.h"
 #include "memlayout.h"
@@ -26,6 +31,7 @@ void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+extern struct iostat iostats;
 
 // console.c
 void            consoleinit(void);
@@ -69,6 +75,42 @@ void            ireclaim(int);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void            kinithart(void);
+void            kmemstat(struct memstat*);
+void            krefinc(void*);
+int             krefcount(void*);
+void*           kzalloc(void);
+int             kzero_idle(void);
+void*           kalloc_pages(int);
+void            kfree_pages(void*, int);
+
+// klog.c
+void            kloginit(void);
+void            klog_write(char*, int);
+int             klog_pending(void);
+int             klog_tx(char*, int);
+void            klog_flush_sync(void);
+int             klog_read(uint64, int);
+
+// fpu.c
+void            fpuinit(void);
+int             fpu_trap(struct proc*);
+void            fpu_enter(struct proc*);
+void            fpu_save(struct proc*);
+void            fpu_restore(struct proc*);
+void            fpu_fork(struct proc*, struct proc*);
+void            fpu_free(struct proc*);
+
+// hrtimer.c
+void            hrtimerinit(void);
+int             hrtimer_start(struct hrtimer*, uint64);
+int             hrtimer_cancel(struct hrtimer*);
+uint64          hrtimer_run(uint64);
+int             hrtimer_sleep(uint64);
+
+// main.c
+void            bootmark(char*);
+void            bootreport(void);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -85,14 +127,17 @@ int             pipewrite(struct pipe*, uint64, int);
 // printf.c
 int             printf(char*, ...) __attribute__ ((format (printf, 1, 2)));
 void            panic(char*) __attribute__((noreturn));
-void            printfinit(void);
+
+// prof.c
+uint64          prof_tick(uint64);
+int             prof_start(int);
+int             prof_copyout(uint64, int);
 
 // proc.c
 int             cpuid(void);
 void            kexit(int);
 int             kfork(void);
-int             growproc(int);
-void            proc_mapstacks(pagetable_t);
+int             growproc(int, uint64*);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kkill(int);
@@ -106,11 +151,29 @@ void            sched(void);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             kwait(uint64);
+int             kclone(uint64, uint64, uint64);
+int             kjoin(uint64);
+int             proc_setvm(struct proc*, pagetable_t, uint64);
 void            wakeup(void*);
+void            wakeup_one(void*);
 void            yield(void);
+void            schedtick(void);
+void            mlfq_boost(void);
+int             setnice(int);
+struct proc*    kthread_create(void (*)(void*), void*, char*);
+void            kthread_exit(void) __attribute__((noreturn));
+void            kthread_join(struct proc*);
+int             setaffinity(int, uint64);
+uint64          getaffinity(int);
+uint64          edf_clock(uint64, int*);
+int             edfset(int, int);
+int             edfyield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             procsnapshot(uint64, int);
+void            procperf(int, struct perfcount*);
+void            tlbshootdown(pagetable_t);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -122,6 +185,7 @@ void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+int             lockstat_copyout(uint64, int, int);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -145,6 +209,7 @@ void            argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+int             sysstat_copyout(uint64, int, int);
 
 // trap.c
 extern uint     ticks;
@@ -152,12 +217,19 @@ void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            prepare_return(void);
+void            ipi_send(int);
+
+// trace.c
+void            trace_record(int, uint64, uint64);
+int             trace_snapshot(int, struct trace_event*, int);
+void            tracedev_register(void);
 
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
 void            uartwrite(char [], int);
 void            uartputc_sync(int);
+void            uartkick(void);
 int             uartgetc(void);
 
 // vm.c
@@ -168,6 +240,7 @@ int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
+uint64          uvmshrink(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
@@ -179,6 +252,9 @@ int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 int             ismapped(pagetable_t, uint64);
 uint64          vmfault(pagetable_t, uint64, int);
+uint64          cowfault(pagetable_t, uint64);
+extern uint64   nvmfault;
+extern uint64   ncowcopy;
 
 // plic.c
 void            plicinit(void);
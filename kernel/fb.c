@@ -9,16 +9,26 @@
 #include "fb.h"
 #include "animation.h"
 
-// Local framebuffer stored inside kernel as a flat buffer (single buffer for stability)
-static uint32 fb_mem[FB_WIDTH * FB_HEIGHT];
+// Local framebuffer, a flat buffer (single buffer for stability) of
+// 2^FB_ORDER contiguous pages from kalloc_pages(), allocated by the
+// first fb_init().
+#define FB_ORDER 4
+static uint32 *fb_mem;
 
 // Exported pointer and size so /dev/fb can reference the framebuffer
-uint32 *fb = fb_mem;
+uint32 *fb;
 int fb_size_bytes = FB_WIDTH * FB_HEIGHT * sizeof(uint32);
 
 void 
 fb_init(void) 
 {
+    if (fb_mem == 0) {
+        if ((PGSIZE << FB_ORDER) < FB_WIDTH * FB_HEIGHT * sizeof(uint32))
+            panic("fb_init: FB_ORDER");
+        if ((fb_mem = kalloc_pages(FB_ORDER)) == 0)
+            panic("fb_init: kalloc_pages");
+        fb = fb_mem;
+    }
     fb_clear(0x000000);
 }
 
@@ -49,6 +49,8 @@ extern struct devsw devsw[];
 #define CONSOLE 1
 // Framebuffer device major number
 #define FB_DEVICE 2
+// Event trace device major number
+#define TRACE_DEVICE 3
 
 #endif
 
@@ -0,0 +1,220 @@
+// kernel/fpu.c
+// Floating-point and vector state of user processes.
+//
+// A process starts with sstatus.FS and VS off, so its first F, D or
+// V instruction traps as illegal.  fpu_trap() then gives it a page
+// for the register state and turns both on; a process that never
+// touches them costs nothing.
+//
+// The registers are switched lazily.  sched() saves them only if
+// the dirty bits the process came into the kernel with say it wrote
+// them.  prepare_return() reloads them only if this hart's registers
+// belong to someone else (cpu->fpowner, p->fpcpu).  The kernel never
+// uses F or V itself, so the registers are left alone between those
+// two points.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "hwcap.h"
+
+// HWCAP_* bits of the harts; set in start() from misa.
+uint64 hwcap;
+
+static uint64 vlenb;       // bytes per vector register
+
+// p->fpstate page layout; the vector registers follow at VOFF.
+struct fpstate {
+  uint64 f[32];
+  uint64 fcsr;
+  uint64 vstart, vl, vtype, vcsr;
+};
+
+#define VOFF 512
+
+void
+fpuinit(void)
+{
+  if(hwcap & HWCAP_V){
+    w_sstatus(r_sstatus() | SSTATUS_VS_INITIAL);
+    asm volatile(".option push\n.option arch, +v\n"
+                 "csrr %0, vlenb\n"
+                 ".option pop" : "=r" (vlenb));
+    w_sstatus(r_sstatus() & ~SSTATUS_VS);
+    if(VOFF + 32*vlenb > PGSIZE){
+      printf("fpu: VLEN %ld too large, vector disabled\n", 8*vlenb);
+      hwcap &= ~HWCAP_V;
+    }
+  }
+}
+
+static void
+fsave(struct fpstate *s)
+{
+  asm volatile(
+    "fsd f0, 0(%0)\n fsd f1, 8(%0)\n fsd f2, 16(%0)\n fsd f3, 24(%0)\n"
+    "fsd f4, 32(%0)\n fsd f5, 40(%0)\n fsd f6, 48(%0)\n fsd f7, 56(%0)\n"
+    "fsd f8, 64(%0)\n fsd f9, 72(%0)\n fsd f10, 80(%0)\n fsd f11, 88(%0)\n"
+    "fsd f12, 96(%0)\n fsd f13, 104(%0)\n fsd f14, 112(%0)\n fsd f15, 120(%0)\n"
+    "fsd f16, 128(%0)\n fsd f17, 136(%0)\n fsd f18, 144(%0)\n fsd f19, 152(%0)\n"
+    "fsd f20, 160(%0)\n fsd f21, 168(%0)\n fsd f22, 176(%0)\n fsd f23, 184(%0)\n"
+    "fsd f24, 192(%0)\n fsd f25, 200(%0)\n fsd f26, 208(%0)\n fsd f27, 216(%0)\n"
+    "fsd f28, 224(%0)\n fsd f29, 232(%0)\n fsd f30, 240(%0)\n fsd f31, 248(%0)\n"
+    : : "r" (s->f) : "memory");
+  asm volatile("frcsr %0" : "=r" (s->fcsr));
+}
+
+static void
+frestore(struct fpstate *s)
+{
+  asm volatile(
+    "fld f0, 0(%0)\n fld f1, 8(%0)\n fld f2, 16(%0)\n fld f3, 24(%0)\n"
+    "fld f4, 32(%0)\n fld f5, 40(%0)\n fld f6, 48(%0)\n fld f7, 56(%0)\n"
+    "fld f8, 64(%0)\n fld f9, 72(%0)\n fld f10, 80(%0)\n fld f11, 88(%0)\n"
+    "fld f12, 96(%0)\n fld f13, 104(%0)\n fld f14, 112(%0)\n fld f15, 120(%0)\n"
+    "fld f16, 128(%0)\n fld f17, 136(%0)\n fld f18, 144(%0)\n fld f19, 152(%0)\n"
+    "fld f20, 160(%0)\n fld f21, 168(%0)\n fld f22, 176(%0)\n fld f23, 184(%0)\n"
+    "fld f24, 192(%0)\n fld f25, 200(%0)\n fld f26, 208(%0)\n fld f27, 216(%0)\n"
+    "fld f28, 224(%0)\n fld f29, 232(%0)\n fld f30, 240(%0)\n fld f31, 248(%0)\n"
+    : : "r" (s->f) : "memory");
+  asm volatile("fscsr %0" : : "r" (s->fcsr));
+}
+
+// whole-register moves, eight registers at a time, do not
+// depend on vl or vtype.
+static void
+vsave(struct fpstate *s)
+{
+  uint64 v = (uint64)s + VOFF, step = 8*vlenb;
+
+  asm volatile(".option push\n.option arch, +v\n"
+               "csrr %0, vstart\n csrr %1, vl\n csrr %2, vtype\n csrr %3, vcsr\n"
+               ".option pop"
+               : "=r" (s->vstart), "=r" (s->vl), "=r" (s->vtype), "=r" (s->vcsr));
+  asm volatile(".option push\n.option arch, +v\n"
+               "vs8r.v v0, (%0)\n add %0, %0, %1\n"
+               "vs8r.v v8, (%0)\n add %0, %0, %1\n"
+               "vs8r.v v16, (%0)\n add %0, %0, %1\n"
+               "vs8r.v v24, (%0)\n"
+               ".option pop"
+               : "+r" (v) : "r" (step) : "memory");
+}
+
+static void
+vrestore(struct fpstate *s)
+{
+  uint64 v = (uint64)s + VOFF, step = 8*vlenb;
+
+  asm volatile(".option push\n.option arch, +v\n"
+               "vl8r.v v0, (%0)\n add %0, %0, %1\n"
+               "vl8r.v v8, (%0)\n add %0, %0, %1\n"
+               "vl8r.v v16, (%0)\n add %0, %0, %1\n"
+               "vl8r.v v24, (%0)\n"
+               ".option pop"
+               : "+r" (v) : "r" (step) : "memory");
+  // vsetvl restores vl and vtype; vstart and vcsr go last,
+  // since vector instructions reset vstart.
+  asm volatile(".option push\n.option arch, +v\n"
+               "vsetvl x0, %0, %1\n csrw vstart, %2\n csrw vcsr, %3\n"
+               ".option pop"
+               : : "r" (s->vl), "r" (s->vtype), "r" (s->vstart), "r" (s->vcsr));
+}
+
+// An illegal instruction trap from user mode.  If p has not used
+// F or V yet, give it a zeroed register state and turn them on;
+// returns 1 if so, and the instruction should be retried.
+int
+fpu_trap(struct proc *p)
+{
+  if(p->fpstate != 0 || (hwcap & (HWCAP_F|HWCAP_V)) == 0)
+    return 0;
+  if((p->fpstate = kzalloc()) == 0)
+    return 0;
+  // make prepare_return() load it.
+  p->fpcpu = -1;
+  return 1;
+}
+
+// Note the dirty bits p entered the kernel with, from usertrap().
+void
+fpu_enter(struct proc *p)
+{
+  if(p->fpstate)
+    p->fpstatus = r_sstatus() & (SSTATUS_FS | SSTATUS_VS);
+}
+
+// Save p's registers if it dirtied them and they are still
+// in this hart's registers.  Interrupts must be off.
+void
+fpu_save(struct proc *p)
+{
+  struct fpstate *s = p->fpstate;
+
+  if(s == 0 || mycpu()->fpowner != p || p->fpcpu != cpuid())
+    return;
+  if((p->fpstatus & SSTATUS_FS) == SSTATUS_FS_DIRTY){
+    w_sstatus(r_sstatus() | SSTATUS_FS_DIRTY);
+    fsave(s);
+    p->fpstatus = (p->fpstatus & ~SSTATUS_FS) | SSTATUS_FS_CLEAN;
+  }
+  if((p->fpstatus & SSTATUS_VS) == SSTATUS_VS_DIRTY){
+    w_sstatus(r_sstatus() | SSTATUS_VS_DIRTY);
+    vsave(s);
+    p->fpstatus = (p->fpstatus & ~SSTATUS_VS) | SSTATUS_VS_CLEAN;
+  }
+}
+
+// Set sstatus.FS and VS for p's return to user space, loading
+// its registers if this hart's hold someone else's.
+// Called from prepare_return() with interrupts off.
+void
+fpu_restore(struct proc *p)
+{
+  struct cpu *c = mycpu();
+  struct fpstate *s = p->fpstate;
+  uint64 x = r_sstatus() & ~(SSTATUS_FS | SSTATUS_VS);
+
+  if(s == 0){
+    w_sstatus(x);
+    return;
+  }
+  if(c->fpowner != p || p->fpcpu != cpuid()){
+    w_sstatus(x | SSTATUS_FS_DIRTY | ((hwcap & HWCAP_V) ? SSTATUS_VS_DIRTY : 0));
+    frestore(s);
+    if(hwcap & HWCAP_V)
+      vrestore(s);
+    p->fpstatus = SSTATUS_FS_CLEAN | ((hwcap & HWCAP_V) ? SSTATUS_VS_CLEAN : 0);
+    c->fpowner = p;
+    p->fpcpu = cpuid();
+  }
+  w_sstatus(x | p->fpstatus);
+}
+
+// Give child np a copy of p's register state, for fork and clone.
+void
+fpu_fork(struct proc *p, struct proc *np)
+{
+  if(p->fpstate == 0)
+    return;
+  if((np->fpstate = kalloc()) == 0)
+    return;  // np just starts with F and V off.
+  push_off();
+  fpu_save(p);
+  pop_off();
+  memmove(np->fpstate, p->fpstate, PGSIZE);
+  np->fpcpu = -1;
+}
+
+// Drop p's register state, on exec and exit.
+void
+fpu_free(struct proc *p)
+{
+  if(p->fpstate)
+    kfree(p->fpstate);
+  p->fpstate = 0;
+  p->fpcpu = -1;
+}
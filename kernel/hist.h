@@ -0,0 +1,21 @@
+#ifndef HIST_H
+#define HIST_H
+
+// log2 histograms shared by the kernel statistics and the user
+// tools that print them.  Bucket b counts values v with
+// 2^b <= v < 2^(b+1); bucket 0 also counts 0.
+
+#define NHIST 32
+
+static inline int
+hist_bucket(uint64 v)
+{
+  int b = 0;
+  while(v > 1 && b < NHIST-1){
+    v >>= 1;
+    b++;
+  }
+  return b;
+}
+
+#endif // HIST_H
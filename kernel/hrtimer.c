@@ -0,0 +1,195 @@
+// kernel/hrtimer.c
+// High-resolution timers.
+//
+// Each hart keeps its pending timers in a binary min-heap ordered
+// by deadline.  clockintr() runs the expired ones and programs
+// stimecmp for whichever comes first: the next tick, profiler
+// sample, EDF event or timer.  A timer runs on the hart it was
+// started on, with interrupts off and its heap's lock held, so
+// hrtimer_cancel() returning means fn has finished.
+//
+// Lock order: a timer heap lock, then a sleep queue lock, then
+// p->lock (the wakeup done by hrtimer_sleep()'s timers).
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "hrtimer.h"
+
+// a process sleeps on at most one timer at a time.
+#define NHRTIMER NPROC
+
+struct hrbase {
+  struct spinlock lock;
+  struct hrtimer *heap[NHRTIMER];
+  int n;
+} __attribute__((aligned(64)));
+
+static struct hrbase bases[NCPU];
+
+void
+hrtimerinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&bases[i].lock, "hrtimer");
+}
+
+static void
+hrswap(struct hrbase *b, int i, int j)
+{
+  struct hrtimer *t = b->heap[i];
+
+  b->heap[i] = b->heap[j];
+  b->heap[j] = t;
+  b->heap[i]->idx = i;
+  b->heap[j]->idx = j;
+}
+
+// restore the heap order around index i.
+static void
+hrfix(struct hrbase *b, int i)
+{
+  while(i > 0 && b->heap[i]->expires < b->heap[(i-1)/2]->expires){
+    hrswap(b, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+  for(;;){
+    int l = 2*i + 1, r = l + 1, m = i;
+    if(l < b->n && b->heap[l]->expires < b->heap[m]->expires)
+      m = l;
+    if(r < b->n && b->heap[r]->expires < b->heap[m]->expires)
+      m = r;
+    if(m == i)
+      break;
+    hrswap(b, i, m);
+    i = m;
+  }
+}
+
+// take t out of its heap.  Caller holds the heap's lock.
+static void
+hrremove(struct hrbase *b, struct hrtimer *t)
+{
+  int i = t->idx;
+
+  b->n--;
+  if(i != b->n){
+    b->heap[i] = b->heap[b->n];
+    b->heap[i]->idx = i;
+    hrfix(b, i);
+  }
+  t->cpu = -1;
+}
+
+// Arm t to call fn from the timer interrupt at time expires,
+// on this hart.  Returns the hart; t->cpu may already be -1 by
+// then if expires is near.  Caller holds no hrtimer lock.
+int
+hrtimer_start(struct hrtimer *t, uint64 expires)
+{
+  struct hrbase *b;
+  int cpu;
+
+  push_off();
+  cpu = cpuid();
+  t->cpu = cpu;
+  t->expires = expires;
+  b = &bases[t->cpu];
+  acquire(&b->lock);
+  if(b->n == NHRTIMER)
+    panic("hrtimer_start");
+  t->idx = b->n++;
+  b->heap[t->idx] = t;
+  hrfix(b, t->idx);
+  // interrupt sooner if this is the earliest event now.
+  if(expires < r_stimecmp())
+    w_stimecmp(expires);
+  release(&b->lock);
+  pop_off();
+  return cpu;
+}
+
+// Disarm t if it has not fired yet.  Returns 1 if it was pending.
+// Caller holds no hrtimer lock.
+int
+hrtimer_cancel(struct hrtimer *t)
+{
+  struct hrbase *b;
+  int cpu, pending = 0;
+
+  // t->cpu only changes under the lock of the heap holding t.
+  while((cpu = t->cpu) >= 0){
+    b = &bases[cpu];
+    acquire(&b->lock);
+    if(t->cpu == cpu){
+      hrremove(b, t);
+      pending = 1;
+    }
+    release(&b->lock);
+    if(pending)
+      break;
+  }
+  return pending;
+}
+
+// Run this hart's timers that are due by now.
+// Returns the next deadline, or 0 if none is pending.
+// Called from clockintr() with interrupts off.
+uint64
+hrtimer_run(uint64 now)
+{
+  struct hrbase *b = &bases[cpuid()];
+  uint64 next = 0;
+
+  acquire(&b->lock);
+  while(b->n > 0 && b->heap[0]->expires <= now){
+    struct hrtimer *t = b->heap[0];
+    hrremove(b, t);
+    t->fn(t);
+  }
+  if(b->n > 0)
+    next = b->heap[0]->expires;
+  release(&b->lock);
+  return next;
+}
+
+static void
+hrtimer_wake(struct hrtimer *t)
+{
+  wakeup(t);
+}
+
+// Sleep until r_time() reaches expires.  Only the timer wakes the
+// sleeper, at its own deadline, not every clock tick.
+// Returns 0, or -1 if the process was killed first.
+int
+hrtimer_sleep(uint64 expires)
+{
+  struct hrtimer t;
+  struct hrbase *b;
+  int r = 0;
+
+  if(expires <= r_time())
+    return 0;
+  t.fn = hrtimer_wake;
+  t.arg = 0;
+  // the heap lock is the condition lock: the timer fires
+  // (sets t.cpu to -1 and wakes us) only while holding it.
+  // It may have fired already, so don't look at t.cpu for it.
+  b = &bases[hrtimer_start(&t, expires)];
+  acquire(&b->lock);
+  while(t.cpu >= 0){
+    if(killed(myproc())){
+      hrremove(b, &t);
+      r = -1;
+      break;
+    }
+    sleep(&t, &b->lock);
+  }
+  release(&b->lock);
+  return r;
+}
@@ -0,0 +1,15 @@
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+// A one-shot timer on a time CSR deadline (see hrtimer.c).
+// Owned by the caller, who must not reuse or free it while
+// it is pending; hrtimer_cancel() guarantees fn is done.
+struct hrtimer {
+  uint64 expires;                 // r_time() deadline
+  void (*fn)(struct hrtimer*);    // called from the timer interrupt
+  void *arg;
+  int cpu;                        // hart whose heap holds it, -1 if none
+  int idx;                        // position in that heap
+};
+
+#endif // HRTIMER_H
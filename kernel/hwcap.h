@@ -0,0 +1,11 @@
+#ifndef HWCAP_H
+#define HWCAP_H
+
+// ISA extensions user code may use, as returned by hwcap().
+// Shared with user programs.
+
+#define HWCAP_F  (1 << 0)   // single-precision floating point
+#define HWCAP_D  (1 << 1)   // double-precision floating point
+#define HWCAP_V  (1 << 2)   // vector extension
+
+#endif // HWCAP_H
@@ -0,0 +1,31 @@
+#ifndef IOSTAT_H
+#define IOSTAT_H
+
+#include "hist.h"
+
+// Block I/O statistics: buffer cache, virtio disk and log commits,
+// copied out by the iostat() system call.
+// Latencies are in units of the time CSR (TIMEBASE Hz).
+
+#define IOSTAT_NDEPTH  16    // queue depths 0..15 counted exactly
+#define IOSTAT_NLOG    32    // commit sizes 0..31 blocks counted exactly
+#define IO_RESET       1     // iostat() flag: zero counters after copying
+
+struct iostat {
+  // buffer cache (bio.c)
+  uint64 bhits;               // bread()/bget() found the block cached
+  uint64 bmisses;             // had to recycle a buffer
+  uint64 bevicts;             // ... that held another valid block
+
+  // virtio disk (virtio_disk.c)
+  uint64 reads;               // completed read requests
+  uint64 writes;              // completed write requests
+  uint32 lat[NHIST];          // submit-to-interrupt latency, log2
+  uint32 depth[IOSTAT_NDEPTH];// requests in flight, sampled at submit
+
+  // log (log.c)
+  uint64 commits;             // non-empty commits
+  uint32 commitsz[IOSTAT_NLOG]; // blocks per commit; last bucket is ">="
+};
+
+#endif // IOSTAT_H
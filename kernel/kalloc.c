@@ -1,6 +1,7 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or physically contiguous runs of 2^order pages.
 
 #include "types.h"
 #include "param.h"
@@ -8,8 +9,9 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "memstat.h"
 
-void freerange(void *pa_start, void *pa_end);
+static void freechunks(void);
 
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
@@ -18,31 +20,247 @@ struct run {
   struct run *next;
 };
 
+// Free memory not in a per-hart cache or the zeroed pool is kept
+// by a binary buddy allocator: free blocks of 2^order pages, order
+// 0 to MAXORDER, each aligned to its size in physical memory, on
+// one list per order.  An allocation splits the smallest free block
+// big enough; a free merges the block with its buddy (the other half
+// of the block twice its size) for as long as the buddy is free too.
+// border[] holds order+1 for the first page of each free block and
+// 0 for every other page, so finding a free buddy is one lookup;
+// the lists are doubly linked so that buddy comes off in O(1).
+#define MAXORDER (MEMSTAT_NORDER - 1)
+#define NPAGE ((PHYSTOP - KERNBASE) / PGSIZE)
+#define PA2PG(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define PG2PA(pg) ((char*)KERNBASE + (uint64)(pg) * PGSIZE)
+
+struct block {
+  struct block *next;
+  struct block *prev;
+};
+
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct block *free[MAXORDER+1];
+  uint64 nfree[MAXORDER+1];  // blocks on each list
+  struct memstat stat;       // page counters, except faults; free and
+                             // minfree count only the buddy lists here
 } kmem;
 
+static uchar border[NPAGE];
+
+// Per-hart caches of free pages.  kalloc() and kfree() work on
+// the calling hart's cache, taking PCP_BATCH pages from the buddy
+// lists when it is empty and giving PCP_BATCH back when it holds
+// more than PCP_HIGH, so kmem.lock is taken once per batch rather
+// than once per page.  A hart that finds both its cache and the
+// buddy lists empty steals half of another hart's cache.
+// Each cache has a lock, normally taken only by its own hart.
+// Lock order: a cache lock, then kmem.lock.
+#define PCP_BATCH 32
+#define PCP_HIGH  128
+
+struct pcp {
+  struct spinlock lock;
+  struct run *list;
+  int n;
+  uint64 allocs;           // kalloc()s and kzalloc()s on this hart
+  uint64 frees;            // pages freed into it
+  uint64 fails;            // those that found no free page
+} __attribute__((aligned(64)));
+
+static struct pcp pcps[NCPU];
+
+// Pages zeroed ahead of time, for kzalloc().  Idle harts top the
+// pool up to ZPOOL_HIGH from the scheduler (kzero_idle()), so a
+// zeroed allocation on the fault path is a list pop.  The pages
+// still count as free: kalloc() takes them back when all the
+// caches are empty.  The link word is the only non-zero word of a
+// pooled page; kzalloc() clears it.
+#define ZPOOL_HIGH 256
+
+static struct {
+  struct spinlock lock;
+  struct run *list;
+  int n;
+  uint64 hits;             // kzalloc()s served from the pool
+} zpool;
+
+// References to each allocated page: page tables mapping it, after
+// copy-on-write fork, or 1 for any other use.  kalloc() sets it to
+// 1, krefinc() adds one, kfree() drops one and frees at zero.
+// Updated with atomics, not kmem.lock.
+// A block from kalloc_pages() has a count in its first page only.
+#define PA2REF(pa) PA2PG(pa)
+static int pgref[NPAGE];
+
+// Building the free lists touches every page of RAM (and junk-fills
+// it under KALLOC_JUNK), so all harts share it: the range is cut
+// into chunks of FREECHUNK pages, each hart claims chunks with an
+// atomic counter and frees a chunk's pages into the buddy lists, as
+// the biggest aligned blocks that fit, under kmem.lock.  Harts other
+// than 0 join via kinithart() before they wait for main() to
+// finish; hart 0 does whatever is left.
+#define FREECHUNK 256
+
+static struct {
+  char *base;              // first page of the pool
+  int npage;
+  int nchunk;
+  volatile int go;         // hart 0 has set up; others may help
+  int next;                // next chunk to claim (atomic)
+  int done;                // chunks spliced in (atomic)
+  int helpers;             // harts other than 0 that helped
+} finit;
+
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
-  freerange(end, (void*)PHYSTOP);
+  for(int i = 0; i < NCPU; i++)
+    initlock(&pcps[i].lock, "kmem_pcp");
+  initlock(&zpool.lock, "kmem_zero");
+
+  finit.base = (char*)PGROUNDUP((uint64)end);
+  finit.npage = ((char*)PHYSTOP - finit.base) / PGSIZE;
+  finit.nchunk = (finit.npage + FREECHUNK - 1) / FREECHUNK;
+  __sync_synchronize();
+  finit.go = 1;
+
+  freechunks();
+  while(__atomic_load_n(&finit.done, __ATOMIC_ACQUIRE) < finit.nchunk)
+    ;
+
+  // the pages added above are the pool, not frees.
+  acquire(&kmem.lock);
+  kmem.stat.total = kmem.stat.free;
+  kmem.stat.minfree = kmem.stat.free;
+  release(&kmem.lock);
+
+  printf("kinit: %d pages, %d harts\n", finit.npage, finit.helpers + 1);
+}
+
+// Put b on the order list.  Caller holds kmem.lock.
+static void
+bpush(struct block *b, int order)
+{
+  b->prev = 0;
+  b->next = kmem.free[order];
+  if(b->next)
+    b->next->prev = b;
+  kmem.free[order] = b;
+  kmem.nfree[order]++;
+  border[PA2PG(b)] = order + 1;
 }
 
+// Take b off the order list.  Caller holds kmem.lock.
+static void
+bunlink(struct block *b, int order)
+{
+  if(b->prev)
+    b->prev->next = b->next;
+  else
+    kmem.free[order] = b->next;
+  if(b->next)
+    b->next->prev = b->prev;
+  kmem.nfree[order]--;
+  border[PA2PG(b)] = 0;
+}
+
+// Allocate a block of 2^order pages, splitting a bigger one if
+// need be.  Returns 0 if none is free.  Caller holds kmem.lock.
+static char*
+bget(int order)
+{
+  struct block *b;
+  int k;
+
+  for(k = order; k <= MAXORDER && kmem.free[k] == 0; k++)
+    ;
+  if(k > MAXORDER)
+    return 0;
+  b = kmem.free[k];
+  bunlink(b, k);
+  // give back the upper halves.
+  while(k > order){
+    k--;
+    bpush((struct block*)((char*)b + (PGSIZE << k)), k);
+  }
+  kmem.stat.free -= 1 << order;
+  if(kmem.stat.free < kmem.stat.minfree)
+    kmem.stat.minfree = kmem.stat.free;
+  return (char*)b;
+}
+
+// Free a block of 2^order pages, merging it with free buddies.
+// Caller holds kmem.lock.
+static void
+bput(char *pa, int order)
+{
+  uint64 pg = PA2PG(pa);
+
+  kmem.stat.free += 1 << order;
+  while(order < MAXORDER){
+    uint64 buddy = pg ^ (1UL << order);
+    if(buddy >= NPAGE || border[buddy] != order + 1)
+      break;
+    bunlink((struct block*)PG2PA(buddy), order);
+    pg &= ~(1UL << order);
+    order++;
+  }
+  bpush((struct block*)PG2PA(pg), order);
+}
+
+// called by harts other than 0 during boot.
 void
-freerange(void *pa_start, void *pa_end)
+kinithart(void)
+{
+  while(finit.go == 0)
+    ;
+  __sync_synchronize();
+  freechunks();
+}
+
+// claim and free chunks until none are left.
+static void
+freechunks(void)
 {
-  char *p;
-  p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-    kfree(p);
+  int c, n, helped = 0;
+
+  while((c = __sync_fetch_and_add(&finit.next, 1)) < finit.nchunk){
+    if(!helped && cpuid() != 0)
+      __sync_fetch_and_add(&finit.helpers, 1);
+    helped = 1;
+
+    char *pa = finit.base + (uint64)c * FREECHUNK * PGSIZE;
+
+    n = finit.npage - c * FREECHUNK;
+    if(n > FREECHUNK)
+      n = FREECHUNK;
+#ifdef KALLOC_JUNK
+    // Fill with junk to catch dangling refs.
+    memset(pa, 1, (uint64)n * PGSIZE);
+#endif
+
+    acquire(&kmem.lock);
+    while(n > 0){
+      // the biggest block aligned at pa that fits.
+      int order = 0;
+      while(order < MAXORDER && (PA2PG(pa) & (1UL << order)) == 0 &&
+            (2 << order) <= n)
+        order++;
+      bput(pa, order);
+      pa += PGSIZE << order;
+      n -= 1 << order;
+    }
+    release(&kmem.lock);
+
+    __sync_fetch_and_add(&finit.done, 1);
+  }
 }
 
 // Free the page of physical memory pointed at by pa,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// which should have been returned by a call to kalloc().
 void
 kfree(void *pa)
 {
@@ -51,17 +269,177 @@ kfree(void *pa)
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  int ref = __sync_sub_and_fetch(&pgref[PA2REF(pa)], 1);
+  if(ref > 0)
+    return;   // still mapped somewhere
+  if(ref < 0)
+    panic("kfree: ref");
+
+#ifdef KALLOC_JUNK
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
+#endif
 
   r = (struct run*)pa;
 
+  push_off();
+  struct pcp *c = &pcps[cpuid()];
+  acquire(&c->lock);
+  r->next = c->list;
+  c->list = r;
+  c->n++;
+  c->frees++;
+  if(c->n > PCP_HIGH){
+    // hand a batch back to the buddy lists.
+    acquire(&kmem.lock);
+    for(int i = 0; i < PCP_BATCH; i++){
+      r = c->list;
+      c->list = r->next;
+      bput((char*)r, 0);
+    }
+    release(&kmem.lock);
+    c->n -= PCP_BATCH;
+  }
+  release(&c->lock);
+  pop_off();
+}
+
+// Move up to PCP_BATCH pages from the buddy lists to cache c.
+// Caller holds c->lock.
+static void
+refill(struct pcp *c)
+{
+  struct run *r;
+
   acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  while(c->n < PCP_BATCH && (r = (struct run*)bget(0)) != 0){
+    r->next = c->list;
+    c->list = r;
+    c->n++;
+  }
   release(&kmem.lock);
 }
 
+// Give every cached page back to the buddy lists, so that they can
+// merge into bigger blocks.
+static void
+drain(void)
+{
+  for(int i = 0; i < NCPU; i++){
+    struct pcp *c = &pcps[i];
+    if(c->n == 0)   // racy peek
+      continue;
+    acquire(&c->lock);
+    acquire(&kmem.lock);
+    while(c->list){
+      struct run *r = c->list;
+      c->list = r->next;
+      bput((char*)r, 0);
+    }
+    c->n = 0;
+    release(&kmem.lock);
+    release(&c->lock);
+  }
+}
+
+// Take half the pages of some other hart's cache.
+// Returns them as a list, or 0 if every cache is empty.
+static struct run*
+steal(int self, int *n)
+{
+  for(int i = 1; i < NCPU; i++){
+    struct pcp *v = &pcps[(self + i) % NCPU];
+    if(v->n == 0)   // racy peek
+      continue;
+    acquire(&v->lock);
+    int take = (v->n + 1) / 2;
+    struct run *head = v->list, *tail = 0;
+    for(int k = 0; k < take; k++){
+      tail = tail ? tail->next : head;
+    }
+    if(tail){
+      v->list = tail->next;
+      v->n -= take;
+      tail->next = 0;
+    }
+    release(&v->lock);
+    if(tail){
+      *n = take;
+      return head;
+    }
+  }
+  return 0;
+}
+
+// Take a page from the calling hart's cache, refilling it from the
+// global list or another hart's cache if it is empty.
+static struct run*
+pcpalloc(void)
+{
+  struct run *r;
+  struct pcp *c;
+  int n;
+
+  push_off();
+  c = &pcps[cpuid()];
+  acquire(&c->lock);
+  if(c->list == 0)
+    refill(c);
+  if(c->list == 0){
+    release(&c->lock);
+    struct run *got = steal(cpuid(), &n);
+    acquire(&c->lock);
+    if(got){
+      // keep the rest for next time.
+      struct run *tail = got;
+      while(tail->next)
+        tail = tail->next;
+      tail->next = c->list;
+      c->list = got;
+      c->n += n;
+    }
+  }
+  r = c->list;
+  if(r){
+    c->list = r->next;
+    c->n--;
+  }
+  release(&c->lock);
+  pop_off();
+  return r;
+}
+
+// Count a kalloc() or kzalloc() call, not kzero_idle()'s pool
+// fills, so that allocs - frees is the pages in use.  Only this
+// hart writes its counters.
+static void
+countalloc(int ok)
+{
+  push_off();
+  struct pcp *c = &pcps[cpuid()];
+  if(ok)
+    c->allocs++;
+  else
+    c->fails++;
+  pop_off();
+}
+
+// Pop a page from the zeroed pool, or return 0.
+static struct run*
+zpoolpop(void)
+{
+  struct run *r;
+
+  acquire(&zpool.lock);
+  r = zpool.list;
+  if(r){
+    zpool.list = r->next;
+    zpool.n--;
+  }
+  release(&zpool.lock);
+  return r;
+}
+
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
@@ -70,13 +448,161 @@ kalloc(void)
 {
   struct run *r;
 
+  if((r = pcpalloc()) == 0)
+    r = zpoolpop();  // last resort; wastes the zeroing
+  countalloc(r != 0);
+  if(r){
+    pgref[PA2REF(r)] = 1;
+#ifdef KALLOC_JUNK
+    memset((char*)r, 5, PGSIZE); // fill with junk
+#endif
+  }
+  return (void*)r;
+}
+
+// Allocate one zeroed page, from the pool if it has one.
+// Returns 0 if the memory cannot be allocated.
+void *
+kzalloc(void)
+{
+  struct run *r;
+
+  if((r = zpoolpop()) != 0){
+    r->next = 0;
+    pgref[PA2REF(r)] = 1;
+    countalloc(1);
+    __sync_fetch_and_add(&zpool.hits, 1);
+    return (void*)r;
+  }
+  if((r = kalloc()) != 0)
+    memset((char*)r, 0, PGSIZE);
+  return (void*)r;
+}
+
+// Called by the scheduler on an idle hart: zero one free page into
+// the pool if it is below ZPOOL_HIGH.  Returns 1 if it did, so the
+// caller can look for work again before zeroing the next one.
+int
+kzero_idle(void)
+{
+  struct run *r;
+
+  if(zpool.n >= ZPOOL_HIGH)   // racy peek
+    return 0;
+  // only from the caches and free list, never back out of the pool.
+  if((r = pcpalloc()) == 0)
+    return 0;
+  memset((char*)r, 0, PGSIZE);
+  acquire(&zpool.lock);
+  r->next = zpool.list;
+  zpool.list = r;
+  zpool.n++;
+  release(&zpool.lock);
+  return 1;
+}
+
+// Allocate 2^order physically contiguous pages, aligned to their
+// size, for the kernel's own use; not for user page tables, since
+// only the first page has a reference count.  Free them with
+// kfree_pages(pa, order).  Returns 0 if no block that big is free,
+// even after the per-hart caches have been given back.
+void *
+kalloc_pages(int order)
+{
+  char *pa;
+
+  if(order == 0)
+    return kalloc();
+  if(order < 0 || order > MAXORDER)
+    return 0;
+
+  for(int tries = 0; ; tries++){
+    acquire(&kmem.lock);
+    pa = bget(order);
+    if(pa)
+      kmem.stat.bigallocs++;
+    else if(tries > 0)
+      kmem.stat.bigfails++;
+    release(&kmem.lock);
+    if(pa || tries > 0)
+      break;
+    drain();
+  }
+
+  if(pa){
+    pgref[PA2REF(pa)] = 1;
+#ifdef KALLOC_JUNK
+    memset(pa, 5, (uint64)PGSIZE << order); // fill with junk
+#endif
+  }
+  return (void*)pa;
+}
+
+// Free a block from kalloc_pages(order).
+void
+kfree_pages(void *pa, int order)
+{
+  if(order == 0){
+    kfree(pa);
+    return;
+  }
+  if(order < 0 || order > MAXORDER ||
+     ((uint64)pa % ((uint64)PGSIZE << order)) != 0 ||
+     (char*)pa < end || (uint64)pa + ((uint64)PGSIZE << order) > PHYSTOP)
+    panic("kfree_pages");
+  if(__sync_sub_and_fetch(&pgref[PA2REF(pa)], 1) != 0)
+    panic("kfree_pages: ref");
+
+#ifdef KALLOC_JUNK
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, (uint64)PGSIZE << order);
+#endif
+
   acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  kmem.stat.bigfrees++;
+  bput((char*)pa, order);
   release(&kmem.lock);
+}
 
-  if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
-  return (void*)r;
+// Add a reference to an allocated page, one more kfree() to go.
+void
+krefinc(void *pa)
+{
+  if(__sync_fetch_and_add(&pgref[PA2REF(pa)], 1) < 1)
+    panic("krefinc");
+}
+
+// References to an allocated page.
+int
+krefcount(void *pa)
+{
+  return __atomic_load_n(&pgref[PA2REF(pa)], __ATOMIC_ACQUIRE);
+}
+
+// Fill in the page counters of *ms.
+void
+kmemstat(struct memstat *ms)
+{
+  acquire(&kmem.lock);
+  *ms = kmem.stat;
+  for(int i = 0; i <= MAXORDER; i++)
+    ms->nfree[i] = kmem.nfree[i];
+  release(&kmem.lock);
+  // pages in the per-hart caches are free too; read racily.
+  // minfree becomes the global list's low point plus what the
+  // caches hold now, an estimate.
+  for(int i = 0; i < NCPU; i++){
+    ms->free += pcps[i].n;
+    ms->minfree += pcps[i].n;
+    ms->allocs += pcps[i].allocs;
+    ms->frees += pcps[i].frees;
+    ms->fails += pcps[i].fails;
+  }
+  if(ms->minfree > ms->free)
+    ms->minfree = ms->free;
+  // so are the pre-zeroed ones.
+  ms->zeroed = zpool.n;
+  ms->zerohits = zpool.hits;
+  ms->free += ms->zeroed;
+  ms->minfree += ms->zeroed;
 }
@@ -0,0 +1,186 @@
+// kernel/klog.c
+// Kernel log: per-hart printf rings, the dmesg history and the
+// asynchronous drain to the UART.
+//
+// printf() formats a whole call into a local buffer and hands it to
+// klog_write(), which copies it into the calling hart's ring with
+// interrupts off.  Only the owning hart writes a ring's head, so the
+// write path takes no lock; a message that does not fit is dropped
+// and counted rather than waited for.
+//
+// klog_pull() moves ring contents, one hart at a time, into a single
+// history buffer under klog.lock.  dmesg() reads the history; the
+// UART transmit interrupt sends it from the tx cursor.  Messages from
+// different harts reach the history whole, but not necessarily in the
+// order they were printed.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "klog.h"
+
+struct klog_ring {
+  uint64 head;       // bytes ever written; only the owning hart
+  uint64 tail;       // bytes ever pulled; klog.lock
+  uint64 dropped;    // messages that did not fit; only the owning hart
+  uint64 reported;   // dropped count already noted in the history; klog.lock
+  char buf[KLOG_RINGSZ];
+} __attribute__((aligned(64)));
+
+static struct klog_ring rings[NCPU];
+
+static struct {
+  struct spinlock lock;
+  uint64 w;              // bytes ever appended to hist
+  uint64 tx;             // bytes of hist handed to the UART
+  char hist[KLOG_HISTSZ];
+} klog;
+
+void
+kloginit(void)
+{
+  initlock(&klog.lock, "klog");
+}
+
+// Append a message to this hart's ring.  Never blocks.
+void
+klog_write(char *s, int n)
+{
+  struct klog_ring *r;
+
+  push_off();
+  r = &rings[cpuid()];
+  if(n > KLOG_RINGSZ - (int)(r->head - r->tail)){
+    r->dropped++;
+  } else {
+    for(int i = 0; i < n; i++)
+      r->buf[(r->head + i) % KLOG_RINGSZ] = s[i];
+    // make the bytes visible before publishing them.
+    __sync_synchronize();
+    r->head += n;
+  }
+  pop_off();
+}
+
+// Is anything waiting in a ring or in the history?
+// A racy hint, for deciding whether to kick the UART.
+int
+klog_pending(void)
+{
+  for(int c = 0; c < NCPU; c++)
+    if(rings[c].head != rings[c].tail)
+      return 1;
+  return klog.tx != klog.w;
+}
+
+static void
+hist_put(char *s, int n)
+{
+  for(int i = 0; i < n; i++)
+    klog.hist[(klog.w + i) % KLOG_HISTSZ] = s[i];
+  klog.w += n;
+}
+
+// Move everything published in the rings into the history.
+// Caller holds klog.lock.
+static void
+klog_pull(void)
+{
+  for(int c = 0; c < NCPU; c++){
+    struct klog_ring *r = &rings[c];
+    uint64 head = r->head;
+    uint64 t = r->tail;
+
+    __sync_synchronize();
+    for(; t != head; t++)
+      hist_put(&r->buf[t % KLOG_RINGSZ], 1);
+    // done reading the bytes before handing their space back.
+    __sync_synchronize();
+    r->tail = t;
+
+    uint64 dropped = r->dropped;
+    if(dropped != r->reported){
+      char msg[] = "[klog: messages dropped]\n";
+      hist_put(msg, sizeof(msg) - 1);
+      r->reported = dropped;
+    }
+  }
+
+  // the UART fell more than a history behind; skip what was lost.
+  if(klog.w - klog.tx > KLOG_HISTSZ)
+    klog.tx = klog.w - KLOG_HISTSZ;
+}
+
+// Take up to max bytes of not-yet-transmitted output for the UART.
+// Called by uart.c with its tx lock held.
+int
+klog_tx(char *dst, int max)
+{
+  int n = 0;
+
+  acquire(&klog.lock);
+  klog_pull();
+  while(n < max && klog.tx != klog.w)
+    dst[n++] = klog.hist[klog.tx++ % KLOG_HISTSZ];
+  release(&klog.lock);
+  return n;
+}
+
+// Write out everything not yet transmitted, synchronously and
+// without locks.  For panic(), when the interrupt-driven drain
+// may never run again.
+void
+klog_flush_sync(void)
+{
+  for(int c = 0; c < NCPU; c++){
+    struct klog_ring *r = &rings[c];
+    for(; r->tail != r->head; r->tail++)
+      hist_put(&r->buf[r->tail % KLOG_RINGSZ], 1);
+  }
+  if(klog.w - klog.tx > KLOG_HISTSZ)
+    klog.tx = klog.w - KLOG_HISTSZ;
+  while(klog.tx != klog.w)
+    uartputc_sync(klog.hist[klog.tx++ % KLOG_HISTSZ]);
+}
+
+// Copy the most recent history, up to n bytes, to user address dst.
+// Returns the number of bytes copied.
+int
+klog_read(uint64 dst, int n)
+{
+  char buf[128];
+  uint64 off, end;
+  int done = 0;
+
+  acquire(&klog.lock);
+  klog_pull();
+  end = klog.w;
+  off = end > KLOG_HISTSZ ? end - KLOG_HISTSZ : 0;
+  if(end - off > n)
+    off = end - n;
+  release(&klog.lock);
+
+  while(off < end){
+    int m = 0;
+    acquire(&klog.lock);
+    if(klog.w - off > KLOG_HISTSZ){
+      // overwritten while we copied; stop at what is still valid.
+      release(&klog.lock);
+      break;
+    }
+    while(m < sizeof(buf) && off + m < end){
+      buf[m] = klog.hist[(off + m) % KLOG_HISTSZ];
+      m++;
+    }
+    release(&klog.lock);
+    if(copyout(myproc()->pagetable, dst + done, buf, m) < 0)
+      return -1;
+    off += m;
+    done += m;
+  }
+  return done;
+}
@@ -0,0 +1,9 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+// Kernel log sizes, shared with user/dmesg.c.
+
+#define KLOG_RINGSZ  4096   // bytes per hart ring (power of two)
+#define KLOG_HISTSZ  16384  // bytes of history kept for dmesg (power of two)
+
+#endif // KLOG_H
@@ -0,0 +1,20 @@
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+// Spinlock statistics, aggregated by lock name across harts and
+// copied out by the lockstat() system call.
+// Times are in units of the time CSR (TIMEBASE Hz).
+
+#define NLOCKSTAT   64     // distinct lock names tracked
+#define LS_RESET    1      // lockstat() flag: zero counters after copying
+
+struct lockstat {
+  char   name[16];
+  uint64 acquire;      // acquisitions
+  uint64 contended;    // acquisitions that had to spin
+  uint64 spin;         // total time spent spinning
+  uint64 hold;         // total time held
+  uint64 maxhold;      // longest single hold
+};
+
+#endif // LOCKSTAT_H
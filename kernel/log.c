@@ -6,6 +6,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "iostat.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -195,6 +196,8 @@ static void
 commit()
 {
   if (log.lh.n > 0) {
+    iostats.commits++;
+    iostats.commitsz[log.lh.n < IOSTAT_NLOG ? log.lh.n : IOSTAT_NLOG-1]++;
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
     install_trans(0); // Now install writes to home locations
@@ -10,35 +10,81 @@ extern void fbdev_register(void);
 
 volatile static int started = 0;
 
+// Boot stage timestamps (r_time(), i.e. since reset), recorded by
+// hart 0 and reported by the first process once it has exec'd init.
+#define NBOOTSTAGE 32
+static struct {
+  char *name;
+  uint64 t;
+} bootstages[NBOOTSTAGE];
+static int nbootstage;
+
+// note that the named boot stage has just finished.
+void
+bootmark(char *name)
+{
+  if(nbootstage < NBOOTSTAGE){
+    bootstages[nbootstage].name = name;
+    bootstages[nbootstage].t = r_time();
+    nbootstage++;
+  }
+}
+
+// print how long each boot stage took, in microseconds.
+void
+bootreport(void)
+{
+  uint64 prev = 0;
+
+  for(int i = 0; i < nbootstage; i++){
+    uint64 t = bootstages[i].t;
+    printf("boot: %s\t%d us (+%d)\n", bootstages[i].name,
+           (int)(t / (TIMEBASE / 1000000)), (int)((t - prev) / (TIMEBASE / 1000000)));
+    prev = t;
+  }
+}
+
 // start() jumps here in supervisor mode on all CPUs.
 void
 main()
 {
   if(cpuid() == 0){
+    bootmark("start");
     consoleinit();
-    printfinit();
+    kloginit();      // kernel log, for printf
     printf("\n");
     printf("xv6 kernel is booting\n");
     printf("\n");
-    kinit();         // physical page allocator
+    bootmark("console");
+    kinit();         // physical page allocator, with the other harts' help
+    bootmark("kinit");
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
+    bootmark("kvminit");
     procinit();      // process table
+    hrtimerinit();   // high-resolution timers
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
+    fpuinit();       // user F/V state
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
+    bootmark("trap/plic");
     // initialize animation and framebuffer device
     animation_init();
     fbdev_register();
+    tracedev_register(); // /dev/trace
+    bootmark("devices");
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
     virtio_disk_init(); // emulated hard disk
+    bootmark("disk");
     userinit();      // first user process
+    bootmark("userinit");
     __sync_synchronize();
     started = 1;
   } else {
+    kinithart();      // help hart 0 build the free list
     while(started == 0)
       ;
     __sync_synchronize();
@@ -17,6 +17,11 @@
 // end -- start of kernel page allocation area
 // PHYSTOP -- end RAM used by the kernel
 
+// core local interruptor (CLINT); writing 1 to a hart's
+// MSIP word raises a machine software interrupt on it.
+#define CLINT 0x2000000L
+#define CLINT_MSIP(hart) (CLINT + 4*(hart))
+
 // qemu puts UART registers here in physical memory.
 #define UART0 0x10000000L
 #define UART0_IRQ 10
@@ -54,6 +59,14 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   THREADFRAMEs (trapframes of clone()d threads)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// a clone()d thread's trapframe, by the thread's p->slot,
+// so threads sharing a page table never collide.
+#define THREADFRAME(slot) (TRAPFRAME - ((slot)+1)*PGSIZE)
+
+// the heap may grow up to here.
+#define USERTOP THREADFRAME(NPROC-1)
@@ -0,0 +1,28 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+// Physical memory and page-fault counters, copied out by memstat().
+// Page counts are in 4096-byte pages; counters are since boot.
+
+#define MEMSTAT_NORDER 11  // buddy block sizes: 1, 2, 4, ... 1024 pages
+
+struct memstat {
+  uint64 total;      // pages managed by kalloc()
+  uint64 free;       // pages free now
+  uint64 minfree;    // fewest pages ever free (high-water mark of use)
+  uint64 allocs;     // successful kalloc() calls
+  uint64 frees;      // kfree() calls
+  uint64 fails;      // kalloc() calls that found no free page
+  uint64 faults;     // pages lazily mapped by vmfault()
+  uint64 cowcopies;  // store faults that copied a page shared by fork
+  uint64 zeroed;     // free pages zeroed by idle harts, waiting (in free)
+  uint64 zerohits;   // kzalloc() calls served by a pre-zeroed page
+  uint64 bigallocs;  // successful kalloc_pages() calls with order > 0
+  uint64 bigfrees;   // kfree_pages() calls with order > 0
+  uint64 bigfails;   // kalloc_pages() calls that found no big enough block
+  uint64 nfree[MEMSTAT_NORDER]; // free blocks of 2^i pages; pages in
+                                // the per-hart caches and the zeroed
+                                // pool are not in any block
+};
+
+#endif // MEMSTAT_H
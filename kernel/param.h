@@ -1,5 +1,6 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC       256  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
+#define CPUMASK_ALL   ((1L << NCPU) - 1)  // affinity: any hart
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
@@ -12,4 +13,10 @@
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define TIMEBASE     10000000  // frequency of the time CSR (qemu virt), Hz
+#define TICKINTERVAL (TIMEBASE/10)  // scheduling tick: 100 ms
+#define NMLFQ        3     // scheduler priority levels, 0 highest
+#define MLFQ_QUANTUM 1     // ticks at level 0; doubles at each lower level
+#define MLFQ_BOOST   50    // ticks between boosts of every queued process to its top level
+#define NICE_MAX     19    // nice() range is 0..NICE_MAX
 
@@ -0,0 +1,17 @@
+#ifndef PERF_H
+#define PERF_H
+
+// Hardware counter totals returned by getperf().
+// cycles and instret are counted on whichever hart ran the process,
+// in kernel and user mode alike; time is in time CSR units (TIMEBASE Hz).
+
+#define PERF_SELF      0   // the calling process
+#define PERF_CHILDREN  1   // its reaped children, and theirs
+
+struct perfcount {
+  uint64 cycles;
+  uint64 instret;
+  uint64 time;
+};
+
+#endif // PERF_H
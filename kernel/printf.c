@@ -18,15 +18,40 @@
 volatile int panicking = 0; // printing a panic message
 volatile int panicked = 0; // spinning forever at end of a panic
 
-// lock to avoid interleaving concurrent printf's.
-static struct {
-  struct spinlock lock;
-} pr;
-
 static char digits[] = "0123456789abcdef";
 
+// printf() formats into one of these on the stack and hands the
+// result to the kernel log (klog.c) in one piece, so output from
+// concurrent printf()s does not interleave unless a single call
+// overflows the buffer.
+struct pbuf {
+  int n;
+  char buf[128];
+};
+
+static void
+pflush(struct pbuf *pb)
+{
+  if(panicking){
+    // synchronous: the asynchronous drain may never run again.
+    for(int i = 0; i < pb->n; i++)
+      consputc(pb->buf[i]);
+  } else {
+    klog_write(pb->buf, pb->n);
+  }
+  pb->n = 0;
+}
+
 static void
-printint(long long xx, int base, int sign)
+putc(struct pbuf *pb, int c)
+{
+  if(pb->n == sizeof(pb->buf))
+    pflush(pb);
+  pb->buf[pb->n++] = c;
+}
+
+static void
+printint(struct pbuf *pb, long long xx, int base, int sign)
 {
   char buf[20];
   int i;
@@ -46,34 +71,35 @@ printint(long long xx, int base, int sign)
     buf[i++] = '-';
 
   while(--i >= 0)
-    consputc(buf[i]);
+    putc(pb, buf[i]);
 }
 
 static void
-printptr(uint64 x)
+printptr(struct pbuf *pb, uint64 x)
 {
   int i;
-  consputc('0');
-  consputc('x');
+  putc(pb, '0');
+  putc(pb, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putc(pb, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
-// Print to the console.
+// Print to the console, by way of the kernel log.
+// Never waits for the UART, except while panicking.
 int
 printf(char *fmt, ...)
 {
   va_list ap;
   int i, cx, c0, c1, c2;
   char *s;
+  struct pbuf pb;
 
-  if(panicking == 0)
-    acquire(&pr.lock);
+  pb.n = 0;
 
   va_start(ap, fmt);
   for(i = 0; (cx = fmt[i] & 0xff) != 0; i++){
     if(cx != '%'){
-      consputc(cx);
+      putc(&pb, cx);
       continue;
     }
     i++;
@@ -82,53 +108,58 @@ printf(char *fmt, ...)
     if(c0) c1 = fmt[i+1] & 0xff;
     if(c1) c2 = fmt[i+2] & 0xff;
     if(c0 == 'd'){
-      printint(va_arg(ap, int), 10, 1);
+      printint(&pb, va_arg(ap, int), 10, 1);
     } else if(c0 == 'l' && c1 == 'd'){
-      printint(va_arg(ap, uint64), 10, 1);
+      printint(&pb, va_arg(ap, uint64), 10, 1);
       i += 1;
     } else if(c0 == 'l' && c1 == 'l' && c2 == 'd'){
-      printint(va_arg(ap, uint64), 10, 1);
+      printint(&pb, va_arg(ap, uint64), 10, 1);
       i += 2;
     } else if(c0 == 'u'){
-      printint(va_arg(ap, uint32), 10, 0);
+      printint(&pb, va_arg(ap, uint32), 10, 0);
     } else if(c0 == 'l' && c1 == 'u'){
-      printint(va_arg(ap, uint64), 10, 0);
+      printint(&pb, va_arg(ap, uint64), 10, 0);
       i += 1;
     } else if(c0 == 'l' && c1 == 'l' && c2 == 'u'){
-      printint(va_arg(ap, uint64), 10, 0);
+      printint(&pb, va_arg(ap, uint64), 10, 0);
       i += 2;
     } else if(c0 == 'x'){
-      printint(va_arg(ap, uint32), 16, 0);
+      printint(&pb, va_arg(ap, uint32), 16, 0);
     } else if(c0 == 'l' && c1 == 'x'){
-      printint(va_arg(ap, uint64), 16, 0);
+      printint(&pb, va_arg(ap, uint64), 16, 0);
       i += 1;
     } else if(c0 == 'l' && c1 == 'l' && c2 == 'x'){
-      printint(va_arg(ap, uint64), 16, 0);
+      printint(&pb, va_arg(ap, uint64), 16, 0);
       i += 2;
     } else if(c0 == 'p'){
-      printptr(va_arg(ap, uint64));
+      printptr(&pb, va_arg(ap, uint64));
     } else if(c0 == 'c'){
-      consputc(va_arg(ap, uint));
+      putc(&pb, va_arg(ap, uint));
     } else if(c0 == 's'){
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        putc(&pb, *s);
     } else if(c0 == '%'){
-      consputc('%');
+      putc(&pb, '%');
     } else if(c0 == 0){
       break;
     } else {
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c0);
+      putc(&pb, '%');
+      putc(&pb, c0);
     }
 
   }
   va_end(ap);
+  pflush(&pb);
 
-  if(panicking == 0)
-    release(&pr.lock);
+  // start the UART if it is idle.  Not while holding a spinlock:
+  // uartintr() calls wakeup(), taking p->lock, under the UART's
+  // lock, so taking that lock here could deadlock.  clockintr()
+  // kicks the UART on behalf of such callers.
+  if(panicking == 0 && (intr_get() || mycpu()->noff == 0))
+    uartkick();
 
   return 0;
 }
@@ -137,15 +168,10 @@ void
 panic(char *s)
 {
   panicking = 1;
+  klog_flush_sync();
   printf("panic: ");
   printf("%s\n", s);
   panicked = 1; // freeze uart output from other CPUs
   for(;;)
     ;
 }
-
-void
-printfinit(void)
-{
-  initlock(&pr.lock, "pr");
-}
@@ -5,20 +5,104 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "trace.h"
+#include "procinfo.h"
+#include "perf.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// Processes are created on demand, a page of struct procs at a
+// time, and never handed back to kalloc: a struct proc stays one
+// (UNUSED while free), so a pointer held by a run queue, a sleep
+// queue or a lockless reader never turns into something else.
+// Every struct proc is on allproc, newest first, for the few
+// places that must visit them all; free ones are also on
+// ptable.free.  At most NPROC exist; each has a slot number,
+// which places its kernel stack and its THREADFRAME.
+struct proc *allproc;
+
+static struct {
+  struct spinlock lock;
+  struct proc *free;       // UNUSED procs, linked by p->freenext
+  int nslot;               // struct procs created so far
+} ptable;
 
 struct proc *initproc;
 
+// Processes by pid, chained through p->pidnext; pid_lock.
+#define NPIDHASH 64
+static struct proc *pidhash[NPIDHASH];
+
 int nextpid = 1;
 struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static int waitchild(uint64 addr, int threads);
+static void chargetime(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
+extern pagetable_t kernel_pagetable; // vm.c
+
+// Per-hart run queues of RUNNABLE processes.
+// A process is on exactly one run queue while it is RUNNABLE,
+// and on none otherwise; setrunnable() makes both true at once.
+// Lock order: p->lock, then a run queue lock.  scheduler()
+// dequeues without p->lock and only then acquires it.
+//
+// Each queue is a multi-level feedback queue: one FIFO per
+// priority level, served highest level first.  A process that
+// uses up its quantum (see schedtick()) drops a level; one that
+// sleeps first keeps its level and what is left of its quantum.
+// Every MLFQ_BOOST ticks mlfq_boost() lifts every queued process
+// back to the top level its nice value allows.
+struct runq {
+  struct spinlock lock;
+  struct proc *head[NMLFQ];
+  struct proc *tail[NMLFQ];
+  int n;                   // length; read without the lock as a hint
+} __attribute__((aligned(64)));
+
+static struct runq runqs[NCPU];
+
+// Sleeping processes, hashed by wait channel, so that wakeup()
+// visits only processes that might be waiting on its channel.
+// A process is on the queue for p->chan exactly while SLEEPING.
+// Lock order: a sleep queue lock, then p->lock.
+#define NSLEEPQ 64
+
+struct sleepq {
+  struct spinlock lock;
+  struct proc *head;       // oldest sleeper first
+  struct proc *tail;
+} __attribute__((aligned(64)));
+
+static struct sleepq sleepqs[NSLEEPQ];
+
+static struct sleepq*
+sleepq_of(void *chan)
+{
+  uint64 a = (uint64)chan;
+  return &sleepqs[((a >> 3) ^ (a >> 11)) % NSLEEPQ];
+}
+
+// The earliest-deadline-first class.  A process that has called
+// edfset(period, budget) is entitled to budget time units of CPU
+// in each period and runs ahead of every MLFQ process; among EDF
+// processes the earliest deadline (end of the current period) wins,
+// on whichever hart is free (global EDF).  A RUNNABLE EDF process
+// is on edf.ready, or, once it has used its budget for this period,
+// on edf.throttled until the period ends.  Both lists are sorted by
+// deadline and protected by edf.lock, which, like a run queue lock,
+// comes after p->lock.  The edf_ fields of a queued process are
+// protected by edf.lock.
+static struct {
+  struct spinlock lock;
+  struct proc *ready;
+  struct proc *throttled;
+  uint64 nextrelease;      // earliest throttled deadline, 0 if none; racy reads
+  uint64 util;             // sum of admitted budget/period, parts per million
+} edf;
 
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
@@ -26,36 +110,125 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
-void
-proc_mapstacks(pagetable_t kpgtbl)
+// Carve a fresh page into struct procs and put them on the free
+// list.  Caller must hold ptable.lock.
+// Returns 0, or -1 if out of memory or at NPROC.
+static int
+procgrow(void)
 {
+  char *page;
   struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
+
+  if(ptable.nslot >= NPROC || (page = kzalloc()) == 0)
+    return -1;
+  for(p = (struct proc*)page; p + 1 <= (struct proc*)(page + PGSIZE); p++){
+    if(ptable.nslot >= NPROC)
+      break;
+    initlock(&p->lock, "proc");
+    p->state = UNUSED;
+    p->slot = ptable.nslot++;
+    p->freenext = ptable.free;
+    ptable.free = p;
+    p->allnext = allproc;
+    // the proc must look initialized before readers can find it.
+    __sync_synchronize();
+    allproc = p;
+  }
+  return 0;
+}
+
+// kernel stacks mapped so far; see stackalloc().
+static uint64 kstackgen;
+
+// Give p a kernel stack, the first time its slot is used.
+// Mapped high in memory, followed by an invalid guard page,
+// and kept while the struct proc is reused.
+// Caller must hold ptable.lock, which serializes changes to
+// the kernel page table.
+static int
+stackalloc(struct proc *p)
+{
+  char *pa;
+  uint64 va = KSTACK(p->slot);
+
+  if((pa = kalloc()) == 0)
+    return -1;
+  if(mappages(kernel_pagetable, va, PGSIZE, (uint64)pa, PTE_R | PTE_W) != 0){
+    kfree(pa);
+    return -1;
+  }
+  // a hart may have cached the old, invalid translation (the
+  // privileged spec allows it), so flush here, and have every
+  // other hart flush before it next switches to a process, which
+  // is the only way it comes to run on this stack.
+  sfence_vma();
+  __atomic_fetch_add(&kstackgen, 1, __ATOMIC_RELEASE);
+  p->kstack = va;
+  return 0;
+}
+
+// Look up the process with the given pid.
+// Returns it with p->lock held, or 0.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  acquire(&pid_lock);
+  for(p = pidhash[pid % NPIDHASH]; p; p = p->pidnext)
+    if(p->pid == pid)
+      break;
+  release(&pid_lock);
+  if(p == 0)
+    return 0;
+
+  // p may have been freed, or even reused, since.
+  acquire(&p->lock);
+  if(p->pid != pid || p->state == UNUSED){
+    release(&p->lock);
+    return 0;
+  }
+  return p;
+}
+
+// Make p a child of parent.  Caller must hold wait_lock.
+static void
+adopt(struct proc *parent, struct proc *p)
+{
+  p->parent = parent;
+  p->sibling = parent->children;
+  parent->children = p;
+}
+
+// Take p off its parent's list of children.
+// Caller must hold wait_lock.
+static void
+orphan(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &p->parent->children; *pp; pp = &(*pp)->sibling){
+    if(*pp == p){
+      *pp = p->sibling;
+      break;
+    }
   }
+  p->parent = 0;
+  p->sibling = 0;
 }
 
 // initialize the proc table.
 void
 procinit(void)
 {
-  struct proc *p;
-  
+  initlock(&ptable.lock, "ptable");
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-      p->state = UNUSED;
-      p->kstack = KSTACK((int) (p - proc));
-  }
+  initlock(&edf.lock, "edf");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&runqs[i].lock, "runq");
+  for(int i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepqs[i].lock, "sleepq");
 }
 
 // Must be called with interrupts disabled,
@@ -89,6 +262,450 @@ myproc(void)
   return p;
 }
 
+// the highest level a process with the given nice value may hold.
+static int
+toplevel(int nice)
+{
+  return nice * NMLFQ / (NICE_MAX + 1);
+}
+
+// Append p to the list for level l.  Caller holds rq->lock.
+static void
+runq_append(struct runq *rq, struct proc *p, int l)
+{
+  p->rqnext = 0;
+  if(rq->tail[l])
+    rq->tail[l]->rqnext = p;
+  else
+    rq->head[l] = p;
+  rq->tail[l] = p;
+  rq->n++;
+}
+
+// Remove and return the first process at level l that may run
+// on hart cpu (any, if cpu is -1), or 0.  Caller holds rq->lock.
+static struct proc*
+runq_take(struct runq *rq, int l, int cpu)
+{
+  struct proc *p, *prev = 0;
+
+  for(p = rq->head[l]; p; prev = p, p = p->rqnext){
+    if(cpu >= 0 && (p->cpumask & (1L << cpu)) == 0)
+      continue;
+    if(prev)
+      prev->rqnext = p->rqnext;
+    else
+      rq->head[l] = p->rqnext;
+    if(rq->tail[l] == p)
+      rq->tail[l] = prev;
+    p->rqnext = 0;
+    rq->n--;
+    return p;
+  }
+  return 0;
+}
+
+// Append p to run queue rq.
+static void
+runq_push(struct runq *rq, struct proc *p)
+{
+  acquire(&rq->lock);
+  runq_append(rq, p, p->level);
+  release(&rq->lock);
+}
+
+// Remove and return the highest-priority process on rq that
+// may run on hart cpu (any, if cpu is -1), or 0.
+static struct proc*
+runq_pop(struct runq *rq, int cpu)
+{
+  struct proc *p = 0;
+
+  acquire(&rq->lock);
+  for(int l = 0; l < NMLFQ && p == 0; l++)
+    p = runq_take(rq, l, cpu);
+  release(&rq->lock);
+  return p;
+}
+
+// Boosts so far.  A process whose boostepoch lags has missed one,
+// and mlfq_catchup() lifts it when it next queues or runs.
+static int mlfq_epoch;
+
+// Lift every process to its top level, with a fresh quantum, so
+// that nothing starves below a stream of higher-priority work.
+// Called by hart 0 every MLFQ_BOOST ticks.  Sleeping and running
+// processes catch up through the epoch; queued ones are also
+// moved up now, and get their new level when they are switched in.
+void
+mlfq_boost(void)
+{
+  __atomic_fetch_add(&mlfq_epoch, 1, __ATOMIC_RELAXED);
+  for(int i = 0; i < NCPU; i++){
+    struct runq *rq = &runqs[i];
+    struct proc *p;
+
+    acquire(&rq->lock);
+    for(int l = 1; l < NMLFQ; l++){
+      // detach level l, then re-append each process where it belongs.
+      struct proc *list = rq->head[l];
+      rq->head[l] = rq->tail[l] = 0;
+      while((p = list) != 0){
+        list = p->rqnext;
+        rq->n--;
+        runq_append(rq, p, toplevel(p->nice));
+      }
+    }
+    release(&rq->lock);
+  }
+}
+
+// Apply a boost p has missed.  Caller holds p->lock.
+static void
+mlfq_catchup(struct proc *p)
+{
+  int epoch = __atomic_load_n(&mlfq_epoch, __ATOMIC_RELAXED);
+
+  if(p->boostepoch != epoch){
+    p->boostepoch = epoch;
+    p->level = toplevel(p->nice);
+    p->quantum = MLFQ_QUANTUM << p->level;
+  }
+}
+
+// Take work from the longest other run queue, or return 0.
+static struct proc*
+runq_steal(int self)
+{
+  int busiest = -1, most = 0;
+
+  for(int i = 0; i < NCPU; i++){
+    if(i != self && runqs[i].n > most){
+      most = runqs[i].n;
+      busiest = i;
+    }
+  }
+  if(busiest < 0)
+    return 0;
+
+  // everything on the busiest queue may be pinned to its own
+  // hart, so fall back to the others.
+  struct proc *p = runq_pop(&runqs[busiest], self);
+  for(int i = 0; i < NCPU && p == 0; i++)
+    if(i != self && i != busiest && runqs[i].n > 0)
+      p = runq_pop(&runqs[i], self);
+  return p;
+}
+
+// Is a process that may run on hart cpu queued on any hart?
+// For an idle hart about to wfi; see scheduler().
+static int
+runq_runnable(int cpu)
+{
+  for(int i = 0; i < NCPU; i++){
+    struct runq *rq = &runqs[i];
+    struct proc *p = 0;
+
+    if(rq->n == 0)   // racy peek, after the caller's fence
+      continue;
+    acquire(&rq->lock);
+    for(int l = 0; l < NMLFQ && p == 0; l++)
+      for(p = rq->head[l]; p; p = p->rqnext)
+        if(p->cpumask & (1L << cpu))
+          break;
+    release(&rq->lock);
+    if(p)
+      return 1;
+  }
+  return 0;
+}
+
+// Harts that have entered scheduler(), one bit each.
+static uint64 cpuonline;
+
+// insert p into a deadline-sorted list.  Caller holds edf.lock.
+static void
+edf_insert(struct proc **list, struct proc *p)
+{
+  while(*list && (*list)->edf_deadline <= p->edf_deadline)
+    list = &(*list)->rqnext;
+  p->rqnext = *list;
+  *list = p;
+}
+
+// start a new period if the current one is over.
+// Caller holds p->lock or, while p is queued, edf.lock.
+static void
+edf_rollover(struct proc *p, uint64 now)
+{
+  if(now < p->edf_deadline)
+    return;
+  p->edf_deadline += p->edf_period;
+  if(p->edf_deadline <= now)
+    p->edf_deadline = now + p->edf_period; // slept through whole periods
+  p->edf_used = 0;
+}
+
+// Queue an EDF process on the ready or the throttled list.
+// Returns 1 if it is ready to run now.
+static int
+edf_enqueue(struct proc *p)
+{
+  int ready;
+
+  edf_rollover(p, r_time());
+  acquire(&edf.lock);
+  ready = p->edf_used < p->edf_budget;
+  if(ready){
+    edf_insert(&edf.ready, p);
+  } else {
+    edf_insert(&edf.throttled, p);
+    edf.nextrelease = edf.throttled->edf_deadline;
+  }
+  release(&edf.lock);
+  return ready;
+}
+
+// Take the earliest-deadline ready process that may run on cpu,
+// first moving throttled processes whose period has ended back to
+// the ready list.  Returns 0 if none.
+static struct proc*
+edf_pop(int cpu)
+{
+  struct proc *p, **pp;
+  uint64 now = r_time();
+
+  // racy peek, so harts without EDF work skip the lock.
+  if(edf.ready == 0 && (edf.nextrelease == 0 || now < edf.nextrelease))
+    return 0;
+
+  acquire(&edf.lock);
+  while((p = edf.throttled) != 0 && p->edf_deadline <= now){
+    edf.throttled = p->rqnext;
+    edf_rollover(p, now);
+    edf_insert(&edf.ready, p);
+  }
+  edf.nextrelease = edf.throttled ? edf.throttled->edf_deadline : 0;
+
+  for(pp = &edf.ready; (p = *pp) != 0; pp = &p->rqnext){
+    if(p->cpumask & (1L << cpu)){
+      *pp = p->rqnext;
+      p->rqnext = 0;
+      break;
+    }
+  }
+  release(&edf.lock);
+  return p;
+}
+
+// Called by clockintr() on every timer interrupt.  Returns the
+// time of this hart's next EDF event, 0 if none, and sets *resched
+// if one is due now: the current EDF process has used its budget,
+// or a throttled process's period has ended and it may preempt.
+uint64
+edf_clock(uint64 now, int *resched)
+{
+  struct proc *p = mycpu()->proc;
+  uint64 next = edf.nextrelease;
+
+  if(next != 0 && now >= next){
+    *resched = 1;
+    next = 0;
+  }
+  if(p && p->edf_period){
+    // p is running here, so only this hart changes these fields.
+    uint64 out = p->stime + (p->edf_budget - p->edf_used);
+    if(p->edf_used >= p->edf_budget || now >= out)
+      *resched = 1;
+    else if(next == 0 || out < next)
+      next = out;
+  }
+  return next;
+}
+
+// Make sure a hart notices p, just queued on hart cpu's run queue
+// (cpu -1 for the EDF ready list), without waiting for its next
+// timer interrupt: interrupt cpu if it is idle, else an idle hart
+// p may run on, which will steal it.  If no hart is idle and p is
+// an EDF process, interrupt a hart running an ordinary process so
+// that it yields.  The idle flags are read without locks; see the
+// idle path in scheduler() for why no wakeup is lost.
+static void
+kick(int cpu, struct proc *p)
+{
+  int self;
+
+  push_off();
+  self = cpuid();
+  pop_off();
+
+  if(cpu >= 0 && cpu != self && cpus[cpu].idle){
+    ipi_send(cpu);
+    return;
+  }
+  for(int i = 0; i < NCPU; i++){
+    if(i != self && (p->cpumask & (1L << i)) && cpus[i].idle){
+      ipi_send(i);
+      return;
+    }
+  }
+  if(p->edf_period == 0)
+    return;
+  for(int i = 0; i < NCPU; i++){
+    struct proc *q = cpus[i].proc;
+    if((p->cpumask & (1L << i)) && (cpuonline & (1L << i)) &&
+       (q == 0 || q->edf_period == 0)){
+      // possibly this hart: the IPI then arrives once
+      // interrupts are back on.
+      cpus[i].resched = 1;
+      ipi_send(i);
+      return;
+    }
+  }
+}
+
+// Make sure no hart keeps using TLB entries for pagetable that
+// the caller has just made stale, by unmapping or write-protecting
+// pages.  A hart flushes its TLB in userret on every return to user
+// space, and the kernel reaches user memory only through software
+// walks, so only a hart running a process on pagetable in user
+// mode needs telling: interrupt it and wait until it has trapped.
+// It takes the interrupt at once, since user mode always has
+// interrupts on, and usertrap() notes the trap before any lock.
+void
+tlbshootdown(pagetable_t pagetable)
+{
+  // the caller's PTE stores before the inuser loads.
+  __sync_synchronize();
+  for(int i = 0; i < NCPU; i++){
+    struct cpu *c = &cpus[i];
+    struct proc *q = c->proc;   // racy, but procs are never freed
+    if(q == 0 || q->pagetable != pagetable || c->inuser == 0)
+      continue;
+    uint64 n = c->uentries;
+    ipi_send(i);
+    while(c->inuser && c->uentries == n)
+      ;
+  }
+}
+
+// Mark p RUNNABLE and queue it: an EDF process on the EDF lists,
+// others on a hart its affinity allows: the one it last ran on,
+// whose cache may still be warm, else this one, else the first
+// allowed hart.  Caller holds p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  int cpu;
+
+  if(!holding(&p->lock))
+    panic("setrunnable");
+  p->state = RUNNABLE;
+  if(p->edf_period){
+    if(edf_enqueue(p))
+      kick(-1, p);
+    return;
+  }
+  mlfq_catchup(p);
+  cpu = p->lastcpu;
+  if(cpu < 0 || (p->cpumask & (1L << cpu)) == 0){
+    push_off();
+    cpu = cpuid();
+    pop_off();
+    for(int i = 0; (p->cpumask & (1L << cpu)) == 0 && i < NCPU; i++)
+      cpu = i;
+  }
+  runq_push(&runqs[cpu], p);
+  kick(cpu, p);
+}
+
+// Make the calling process an EDF process with the given period
+// and budget in microseconds, or an ordinary one if period is 0.
+// Admission control: with m harts, the sum of budget/period over
+// all EDF processes may not exceed m - (m-1) * (the largest one),
+// the utilization bound under which global EDF meets every deadline.
+// Returns 0, or -1 if the request is invalid or not admitted.
+int
+edfset(int period_us, int budget_us)
+{
+  struct proc *p = myproc();
+  uint64 period = (uint64)period_us * (TIMEBASE / 1000000);
+  uint64 budget = (uint64)budget_us * (TIMEBASE / 1000000);
+  uint64 u = 0, umax = 0, total = 0;
+  int m = 0;
+
+  if(period_us < 0 || budget_us < 0)
+    return -1;
+  if(period != 0){
+    if(budget == 0 || budget > period)
+      return -1;
+    u = budget * 1000000 / period;
+  }
+  for(int i = 0; i < NCPU; i++)
+    if(cpuonline & (1L << i))
+      m++;
+
+  acquire(&p->lock);
+  acquire(&edf.lock);
+  if(u != 0){
+    struct proc *q;
+    umax = u;
+    for(q = allproc; q; q = q->allnext)
+      if(q != p && q->edf_util > umax)
+        umax = q->edf_util;
+    total = edf.util - p->edf_util + u;
+    if(total > m * 1000000 - (m - 1) * umax){
+      release(&edf.lock);
+      release(&p->lock);
+      return -1;
+    }
+  }
+  edf.util = edf.util - p->edf_util + u;
+  p->edf_util = u;
+  release(&edf.lock);
+
+  p->edf_period = period;
+  p->edf_budget = budget;
+  p->edf_used = 0;
+  p->edf_deadline = r_time() + period;
+  release(&p->lock);
+  return 0;
+}
+
+// Give back the rest of this period's budget: the calling EDF
+// process has finished its work for the period.  Returns 1 if it
+// finished after its deadline, 0 if in time, -1 if not EDF.
+int
+edfyield(void)
+{
+  struct proc *p = myproc();
+  int missed;
+
+  acquire(&p->lock);
+  if(p->edf_period == 0){
+    release(&p->lock);
+    return -1;
+  }
+  missed = r_time() > p->edf_deadline;
+  chargetime(p);
+  p->edf_used = p->edf_budget;  // throttled until the period ends
+  setrunnable(p);
+  sched();
+  release(&p->lock);
+  return missed;
+}
+
+// drop p's EDF admission, e.g. when it exits.  Caller holds p->lock.
+static void
+edf_leave(struct proc *p)
+{
+  acquire(&edf.lock);
+  edf.util -= p->edf_util;
+  release(&edf.lock);
+  p->edf_util = 0;
+  p->edf_period = 0;
+}
+
 int
 allocpid()
 {
@@ -102,28 +719,79 @@ allocpid()
   return pid;
 }
 
-// Look in the process table for an UNUSED proc.
-// If found, initialize state required to run in the kernel,
+// Take an UNUSED proc off the free list, creating more if need be.
+// Initialize state required to run in the kernel,
 // and return with p->lock held.
-// If there are no free procs, or a memory allocation fails, return 0.
+// If there are no free procs, or memory runs out, return 0.
 static struct proc*
-allocproc(void)
+allocslot(void)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
-    }
+  acquire(&ptable.lock);
+  if(ptable.free == 0 && procgrow() < 0){
+    release(&ptable.lock);
+    return 0;
   }
-  return 0;
+  p = ptable.free;
+  if(p->kstack == 0 && stackalloc(p) < 0){
+    release(&ptable.lock);
+    return 0;
+  }
+  ptable.free = p->freenext;
+  release(&ptable.lock);
 
-found:
+  acquire(&p->lock);
+  if(p->state != UNUSED)
+    panic("allocslot");
+  p->freenext = 0;
   p->pid = allocpid();
+  acquire(&pid_lock);
+  p->pidnext = pidhash[p->pid % NPIDHASH];
+  pidhash[p->pid % NPIDHASH] = p;
+  release(&pid_lock);
+  p->children = 0;
+  p->sibling = 0;
   p->state = USED;
+  p->cpu = -1;
+  p->lastcpu = -1;
+  p->cpumask = CPUMASK_ALL;
+  p->sqnext = p->sqprev = 0;
+  p->nice = 0;
+  p->level = 0;
+  p->quantum = MLFQ_QUANTUM;
+  p->rtime = 0;
+  p->ticks = 0;
+  p->nswitch = 0;
+  p->nfault = 0;
+  p->cycles = 0;
+  p->instret = 0;
+  p->crtime = 0;
+  p->ccycles = 0;
+  p->cinstret = 0;
+  p->kfn = 0;
+  p->karg = 0;
+  p->fpstate = 0;
+  p->fpcpu = -1;
+
+  // Set up new context to start executing at forkret,
+  // which returns to user space.
+  memset(&p->context, 0, sizeof(p->context));
+  p->context.ra = (uint64)forkret;
+  p->context.sp = p->kstack + PGSIZE;
+
+  return p;
+}
+
+// Allocate a user process: a slot from allocslot(), a trapframe
+// and an empty user page table.  Returns with p->lock held, or 0.
+static struct proc*
+allocproc(void)
+{
+  struct proc *p;
+
+  if((p = allocslot()) == 0)
+    return 0;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -133,6 +801,7 @@ found:
   }
 
   // An empty user page table.
+  p->tfva = TRAPFRAME;
   p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
     freeproc(p);
@@ -140,35 +809,71 @@ found:
     return 0;
   }
 
-  // Set up new context to start executing at forkret,
-  // which returns to user space.
-  memset(&p->context, 0, sizeof(p->context));
-  p->context.ra = (uint64)forkret;
-  p->context.sp = p->kstack + PGSIZE;
-
   return p;
 }
 
+// Does any process other than p use pagetable?
+// Caller must hold wait_lock.
+static int
+vmshared(struct proc *p, pagetable_t pagetable)
+{
+  for(struct proc *pp = allproc; pp; pp = pp->allnext)
+    if(pp != p && pp->pagetable == pagetable)
+      return 1;
+  return 0;
+}
+
+// Drop p's use of its page table: unmap its trapframe, and free
+// the page table and user memory if no clone()d thread shares them.
+// Caller must hold wait_lock if the page table may be shared.
+static void
+dropvm(struct proc *p, pagetable_t pagetable, uint64 sz)
+{
+  uvmunmap(pagetable, p->tfva, 1, 0);
+  if(!vmshared(p, pagetable)){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, sz);
+  }
+}
+
 // free a proc structure and the data hanging from it,
-// including user pages.
-// p->lock must be held.
+// including user pages, and put it back on the free list.
+// p->lock must be held, and wait_lock if p has a parent or
+// shares its page table.
 static void
 freeproc(struct proc *p)
 {
+  if(p->pagetable)
+    dropvm(p, p->pagetable, p->sz);
+  p->pagetable = 0;
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
-  p->pagetable = 0;
+  fpu_free(p);
   p->sz = 0;
+  if(p->pid != 0){
+    struct proc **pp;
+    acquire(&pid_lock);
+    for(pp = &pidhash[p->pid % NPIDHASH]; *pp != p; pp = &(*pp)->pidnext)
+      ;
+    *pp = p->pidnext;
+    release(&pid_lock);
+  }
   p->pid = 0;
-  p->parent = 0;
+  if(p->parent)
+    orphan(p);
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  if(p->edf_period)
+    edf_leave(p);
   p->state = UNUSED;
+
+  acquire(&ptable.lock);
+  p->freenext = ptable.free;
+  ptable.free = p;
+  release(&ptable.lock);
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -226,31 +931,69 @@ userinit(void)
   
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&p->lock);
 }
 
+// Replace p's page table and size with a new user image, for exec,
+// and free the old ones.  Fails if clone()d threads share them.
+int
+proc_setvm(struct proc *p, pagetable_t pagetable, uint64 sz)
+{
+  pagetable_t old;
+  uint64 oldsz;
+
+  acquire(&wait_lock);
+  if(vmshared(p, p->pagetable)){
+    release(&wait_lock);
+    return -1;
+  }
+  old = p->pagetable;
+  oldsz = p->sz;
+  p->pagetable = pagetable;
+  p->sz = sz;
+  release(&wait_lock);
+
+  dropvm(p, old, oldsz);
+  p->tfva = TRAPFRAME;
+  return 0;
+}
+
 // Grow or shrink user memory by n bytes.
+// Sets *oldsz to the size before.
 // Return 0 on success, -1 on failure.
 int
-growproc(int n)
+growproc(int n, uint64 *oldsz)
 {
   uint64 sz;
   struct proc *p = myproc();
+  struct proc *pp;
 
-  sz = p->sz;
+  // threads sharing the memory resize it one at a time.
+  acquire(&wait_lock);
+  sz = *oldsz = p->sz;
   if(n > 0){
-    if(sz + n > TRAPFRAME) {
+    if(sz + n > USERTOP) {
+      release(&wait_lock);
       return -1;
     }
     if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+      release(&wait_lock);
       return -1;
     }
   } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    // shrink every sharer first; vmfault() checks sz under
+    // faultlock, so none faults pages back in after uvmshrink().
+    for(pp = allproc; pp; pp = pp->allnext)
+      if(pp->pagetable == p->pagetable)
+        pp->sz = sz + n;
+    sz = uvmshrink(p->pagetable, sz, sz + n);
   }
-  p->sz = sz;
+  for(pp = allproc; pp; pp = pp->allnext)
+    if(pp->pagetable == p->pagetable)
+      pp->sz = sz;
+  release(&wait_lock);
   return 0;
 }
 
@@ -267,20 +1010,31 @@ kfork(void)
   if((np = allocproc()) == 0){
     return -1;
   }
+  // np is not RUNNABLE, so nothing else will run it; release
+  // its lock to take wait_lock, which comes first.
+  release(&np->lock);
 
-  // Copy user memory from parent to child.
+  // Copy user memory from parent to child, under wait_lock so
+  // that clone()d threads of the parent do not resize it meanwhile.
+  acquire(&wait_lock);
   if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+    release(&wait_lock);
+    acquire(&np->lock);
     freeproc(np);
     release(&np->lock);
     return -1;
   }
   np->sz = p->sz;
+  release(&wait_lock);
+
+  acquire(&np->lock);
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
 
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
+  fpu_fork(p, np);
 
   // increment reference counts on open file descriptors.
   for(i = 0; i < NOFILE; i++)
@@ -290,16 +1044,103 @@ kfork(void)
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
+  np->cpumask = p->cpumask;
+
+  // the child starts at the top level its inherited nice allows.
+  np->nice = p->nice;
+  np->level = toplevel(np->nice);
+  np->quantum = MLFQ_QUANTUM << np->level;
+
   pid = np->pid;
 
   release(&np->lock);
 
   acquire(&wait_lock);
-  np->parent = p;
+  adopt(p, np);
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  setrunnable(np);
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a thread running fn(arg) on the given user stack, sharing
+// the caller's memory.  It gets its own trapframe, mapped at
+// THREADFRAME(slot), and a copy of the caller's open files; it
+// should exit() rather than return from fn.  The caller reaps it
+// with join().  Returns the thread's pid, or -1.
+int
+kclone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int i, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if(stack % 16 != 0 || stack == 0 || stack > p->sz)
+    return -1;
+
+  if((np = allocslot()) == 0)
+    return -1;
+  if((np->trapframe = (struct trapframe *)kalloc()) == 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  np->tfva = THREADFRAME(np->slot);
+
+  // the thread starts in fn with arg, as if called.
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->trapframe->ra = 0;
+  fpu_fork(p, np);
+
+  for(i = 0; i < NOFILE; i++)
+    if(p->ofile[i])
+      np->ofile[i] = filedup(p->ofile[i]);
+  np->cwd = idup(p->cwd);
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  np->cpumask = p->cpumask;
+  np->nice = p->nice;
+  np->level = toplevel(np->nice);
+  np->quantum = MLFQ_QUANTUM << np->level;
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  // share the page table; wait_lock keeps growproc() and exec
+  // from changing it underneath us.
+  acquire(&wait_lock);
+  if(mappages(p->pagetable, np->tfva, PGSIZE,
+              (uint64)(np->trapframe), PTE_R | PTE_W) < 0){
+    release(&wait_lock);
+    for(i = 0; i < NOFILE; i++)
+      if(np->ofile[i]){
+        fileclose(np->ofile[i]);
+        np->ofile[i] = 0;
+      }
+    begin_op();
+    iput(np->cwd);
+    end_op();
+    np->cwd = 0;
+    acquire(&np->lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  np->pagetable = p->pagetable;
+  np->sz = p->sz;
+  adopt(p, np);
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
@@ -312,12 +1153,13 @@ reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  if(p->children == 0)
+    return;
+  while((pp = p->children) != 0){
+    p->children = pp->sibling;
+    adopt(initproc, pp);
   }
+  wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -369,6 +1211,22 @@ kexit(int status)
 // Return -1 if this process has no children.
 int
 kwait(uint64 addr)
+{
+  return waitchild(addr, 0);
+}
+
+// Wait for a clone()d thread of this process to exit and
+// return its pid.  Return -1 if it has none.
+int
+kjoin(uint64 addr)
+{
+  return waitchild(addr, 1);
+}
+
+// Reap an exited child, or with threads set, only a child
+// sharing this process's page table.
+static int
+waitchild(uint64 addr, int threads)
 {
   struct proc *pp;
   int havekids, pid;
@@ -379,8 +1237,8 @@ kwait(uint64 addr)
   for(;;){
     // Scan through table looking for exited children.
     havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
+    for(pp = p->children; pp; pp = pp->sibling){
+      if(!threads || pp->pagetable == p->pagetable){
         // make sure the child isn't still in exit() or swtch().
         acquire(&pp->lock);
 
@@ -394,6 +1252,9 @@ kwait(uint64 addr)
             release(&wait_lock);
             return -1;
           }
+          p->crtime += pp->rtime + pp->crtime;
+          p->ccycles += pp->cycles + pp->ccycles;
+          p->cinstret += pp->instret + pp->cinstret;
           freeproc(pp);
           release(&pp->lock);
           release(&wait_lock);
@@ -414,6 +1275,131 @@ kwait(uint64 addr)
   }
 }
 
+// A kernel thread's first scheduling by scheduler() swtches here.
+static void
+kthread_start(void)
+{
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler, which turned
+  // interrupts off; a kernel thread runs with them on, so
+  // that it can be preempted.
+  release(&p->lock);
+  intr_on();
+
+  p->kfn(p->karg);
+  kthread_exit();
+}
+
+// Create a kernel thread running fn(arg): a process with its own
+// kernel stack but no user memory, page table or trapframe, which
+// is scheduled like any other.  It runs until fn returns or it
+// calls kthread_exit(); someone must then kthread_join() it.
+// Returns the thread, or 0 if the process table is full.
+struct proc*
+kthread_create(void (*fn)(void*), void *arg, char *name)
+{
+  struct proc *p;
+
+  if((p = allocslot()) == 0)
+    return 0;
+  p->kfn = fn;
+  p->karg = arg;
+  p->context.ra = (uint64)kthread_start;
+  safestrcpy(p->name, name, sizeof(p->name));
+  setrunnable(p);
+  release(&p->lock);
+  return p;
+}
+
+// Exit the current kernel thread.  Does not return.
+void
+kthread_exit(void)
+{
+  struct proc *p = myproc();
+
+  if(p->kfn == 0)
+    panic("kthread_exit");
+
+  acquire(&wait_lock);
+  // a joiner sleeps on the thread itself.
+  wakeup(p);
+  acquire(&p->lock);
+  p->state = ZOMBIE;
+  release(&wait_lock);
+
+  sched();
+  panic("zombie kthread exit");
+}
+
+// Wait for kernel thread t to exit, then free it.
+void
+kthread_join(struct proc *t)
+{
+  acquire(&wait_lock);
+  for(;;){
+    acquire(&t->lock);
+    if(t->state == ZOMBIE){
+      freeproc(t);
+      release(&t->lock);
+      break;
+    }
+    release(&t->lock);
+    sleep(t, &wait_lock);
+  }
+  release(&wait_lock);
+}
+
+#ifdef KTHREAD_SELFTEST
+// Boot-time check of kernel threads, run by the first process in
+// kernels built with KTHREAD_SELFTEST=1.  The first thread spins
+// until the second has run, which on a single hart needs the first
+// to be preempted.
+static volatile int kttest_flag;
+
+static void
+kttest_spin(void *arg)
+{
+  while(kttest_flag == 0)
+    ;
+}
+
+static void
+kttest_set(void *arg)
+{
+  kttest_flag = 1;
+}
+
+static void
+kthread_selftest(void)
+{
+  struct proc *a, *b;
+
+  if((a = kthread_create(kttest_spin, 0, "kttest")) == 0 ||
+     (b = kthread_create(kttest_set, 0, "kttest")) == 0)
+    panic("kthread_selftest");
+  kthread_join(a);
+  kthread_join(b);
+}
+#endif
+
+// Charge the time p has run since p->stime, to its run time and,
+// for an EDF process, its budget, and restart the count.  Called
+// by yield(), edfyield() and sleep() before p can be queued again:
+// once it is on the EDF lists, edf_pop() on another hart may reset
+// edf_used under edf.lock alone.
+// Caller holds p->lock; p is running on this hart.
+static void
+chargetime(struct proc *p)
+{
+  uint64 now = r_time();
+
+  p->rtime += now - p->stime;
+  if(p->edf_period)
+    p->edf_used += now - p->stime;
+  p->stime = now;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -428,6 +1414,7 @@ scheduler(void)
   struct cpu *c = mycpu();
 
   c->proc = 0;
+  __sync_fetch_and_or(&cpuonline, 1L << cpuid());
   for(;;){
     // The most recent process to run may have had interrupts
     // turned off; enable them to avoid a deadlock if all
@@ -437,28 +1424,82 @@ scheduler(void)
     intr_on();
     intr_off();
 
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        found = 1;
-      }
-      release(&p->lock);
+    // EDF processes first, then our own queue, then another
+    // hart's.  Take anything from our own queue; a process whose
+    // affinity changed while it was queued is moved below.
+    p = edf_pop(cpuid());
+    if(p == 0)
+      p = runq_pop(&runqs[cpuid()], -1);
+    if(p == 0)
+      p = runq_steal(cpuid());
+    if(p == 0){
+      // nothing to run: first zero a page for kzalloc() if the
+      // pool wants one, and look again.
+      if(kzero_idle())
+        continue;
+      // still nothing; stop running on this core until an interrupt.
+      // setrunnable() queues, then reads idle; we set idle, then
+      // look at every queue again, since kick() may have passed
+      // over us for another hart's queue just before we set idle.
+      // So either we see the new process here, or kick() sees idle
+      // and interrupts us out of wfi.
+      c->idle = 1;
+      __sync_synchronize();
+      if(edf.ready == 0 && !runq_runnable(cpuid()))
+        asm volatile("wfi");
+      c->idle = 0;
+      continue;
     }
-    if(found == 0) {
-      // nothing to run; stop running on this core until an interrupt.
-      asm volatile("wfi");
+
+    // p is off the queues, so no other hart will pick it.  It may
+    // still be on its way out of its last hart (e.g. yield()), in
+    // which case acquire() waits for that hart's scheduler to let go.
+    acquire(&p->lock);
+    if(p->state == RUNNABLE && (p->cpumask & (1L << cpuid())) == 0){
+      // its affinity changed while it was queued.
+      setrunnable(p);
+    } else if(p->state == RUNNABLE) {
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      p->state = RUNNING;
+      mlfq_catchup(p);
+      c->proc = p;
+      c->resched = 0;
+      if(c->kstackgen != __atomic_load_n(&kstackgen, __ATOMIC_ACQUIRE)){
+        // p's kernel stack may be newly mapped.
+        c->kstackgen = __atomic_load_n(&kstackgen, __ATOMIC_ACQUIRE);
+        sfence_vma();
+      }
+      p->cpu = cpuid();
+      p->lastcpu = p->cpu;
+      p->nswitch++;
+      trace_record(TR_SWITCH, p->pid, 0);
+      p->stime = r_time();
+      p->scycle = r_cycle();
+      p->sinstret = r_instret();
+      if(p->edf_period){
+        // interrupt when the budget runs out, if before the next
+        // timer event; clockintr() only looks at it on interrupts.
+        uint64 out = p->stime + (p->edf_budget - p->edf_used);
+        if(p->edf_used >= p->edf_budget)
+          out = p->stime;
+        if(out < r_stimecmp())
+          w_stimecmp(out);
+      }
+      swtch(&c->context, &p->context);
+      // the EDF budget was charged before p was queued or slept;
+      // see chargetime().
+      p->rtime += r_time() - p->stime;
+      p->cycles += r_cycle() - p->scycle;
+      p->instret += r_instret() - p->sinstret;
+      p->cpu = -1;
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->proc = 0;
     }
+    release(&p->lock);
   }
 }
 
@@ -484,18 +1525,129 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  // the next process may overwrite F/V registers.
+  fpu_save(p);
+
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
 }
 
+// A scheduling tick arrived while the current process ran.
+// Charge it against the quantum; give up the CPU if the quantum
+// is used up (dropping a level), if something of higher
+// priority is waiting on this hart, or if an EDF event is due.
+void
+schedtick(void)
+{
+  struct proc *p = myproc();
+  struct cpu *c;
+  int preempt = 0;
+
+  // an EDF event came with this tick (see clockintr()).
+  push_off();
+  c = mycpu();
+  if(c->resched){
+    c->resched = 0;
+    preempt = 1;
+  }
+  pop_off();
+
+  acquire(&p->lock);
+  mlfq_catchup(p);
+  if(--p->quantum <= 0){
+    if(p->level < NMLFQ-1)
+      p->level++;
+    p->quantum = MLFQ_QUANTUM << p->level;
+    preempt = 1;
+  } else {
+    // racy peek; a miss only delays the switch by a tick.
+    struct runq *rq = &runqs[cpuid()];
+    for(int l = 0; l < p->level; l++)
+      if(rq->head[l])
+        preempt = 1;
+  }
+  release(&p->lock);
+
+  if(preempt)
+    yield();
+}
+
+// Change the calling process's nice value by inc, within
+// 0..NICE_MAX.  Returns the new value.
+int
+setnice(int inc)
+{
+  struct proc *p = myproc();
+  int nice;
+
+  acquire(&p->lock);
+  nice = p->nice + inc;
+  if(nice < 0)
+    nice = 0;
+  if(nice > NICE_MAX)
+    nice = NICE_MAX;
+  p->nice = nice;
+  if(p->level < toplevel(nice)){
+    p->level = toplevel(nice);
+    p->quantum = MLFQ_QUANTUM << p->level;
+  }
+  release(&p->lock);
+  return nice;
+}
+
+// Restrict process pid (0 for the caller) to the harts in mask.
+// The mask must include a hart that is running.
+// Returns 0, or -1 if there is no such process or hart.
+int
+setaffinity(int pid, uint64 mask)
+{
+  struct proc *p, *me = myproc();
+  int moved = 0;
+
+  mask &= cpuonline;
+  if(mask == 0)
+    return -1;
+  if(pid == 0)
+    pid = me->pid;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->cpumask = mask;
+  // a queued process is moved when a hart dequeues it.
+  if(p == me && (mask & (1L << p->cpu)) == 0)
+    moved = 1;
+  release(&p->lock);
+  if(moved)
+    yield();  // setrunnable() puts us on an allowed hart
+  return 0;
+}
+
+// Return the affinity mask of process pid (0 for the caller),
+// or -1 if there is no such process.
+uint64
+getaffinity(int pid)
+{
+  struct proc *p;
+  uint64 mask;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  mask = p->cpumask;
+  release(&p->lock);
+  return mask;
+}
+
 // Give up the CPU for one scheduling round.
 void
 yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  // before setrunnable(), which checks the EDF budget.
+  chargetime(p);
+  setrunnable(p);
   sched();
   release(&p->lock);
 }
@@ -517,6 +1669,11 @@ forkret(void)
     // regular process (e.g., because it calls sleep), and thus cannot
     // be run from main().
     fsinit(ROOTDEV);
+    bootmark("fsinit");
+#ifdef KTHREAD_SELFTEST
+    kthread_selftest();
+    bootmark("kthreads");
+#endif
 
     first = 0;
     // ensure other cores see first=0.
@@ -528,6 +1685,8 @@ forkret(void)
     if (p->trapframe->a0 == -1) {
       panic("exec");
     }
+    bootmark("exec init");
+    bootreport();
   }
 
   // return to user space, mimicing usertrap()'s return.
@@ -543,20 +1702,33 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *sq = sleepq_of(chan);
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Once we hold the sleep queue lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
-  // so it's okay to release lk.
+  // (wakeup locks the sleep queue), so it's
+  // okay to release lk.  Once we hold p->lock,
+  // a waker that finds us on the queue waits
+  // for sched() to finish switching us out.
 
+  acquire(&sq->lock);
   acquire(&p->lock);  //DOC: sleeplock1
   release(lk);
 
   // Go to sleep.
   p->chan = chan;
+  chargetime(p);
   p->state = SLEEPING;
+  p->sqnext = 0;
+  p->sqprev = sq->tail;
+  if(sq->tail)
+    sq->tail->sqnext = p;
+  else
+    sq->head = p;
+  sq->tail = p;
+  release(&sq->lock);
 
   sched();
 
@@ -568,22 +1740,61 @@ sleep(void *chan, struct spinlock *lk)
   acquire(lk);
 }
 
-// Wake up all processes sleeping on channel chan.
-// Caller should hold the condition lock.
-void
-wakeup(void *chan)
+// Take p off sleep queue sq and make it RUNNABLE.
+// Caller holds sq->lock and p->lock.
+static void
+sleepq_wake(struct sleepq *sq, struct proc *p)
 {
-  struct proc *p;
+  if(p->sqprev)
+    p->sqprev->sqnext = p->sqnext;
+  else
+    sq->head = p->sqnext;
+  if(p->sqnext)
+    p->sqnext->sqprev = p->sqprev;
+  else
+    sq->tail = p->sqprev;
+  p->sqnext = p->sqprev = 0;
+  setrunnable(p);
+}
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
+// Wake up processes sleeping on channel chan, all of them or
+// just the one that has slept longest.
+static void
+wakeup_n(void *chan, int all)
+{
+  struct sleepq *sq = sleepq_of(chan);
+  struct proc *p, *next;
+
+  acquire(&sq->lock);
+  for(p = sq->head; p; p = next){
+    next = p->sqnext;
+    if(p->chan == chan){
       acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
+      sleepq_wake(sq, p);
       release(&p->lock);
+      if(!all)
+        break;
     }
   }
+  release(&sq->lock);
+}
+
+// Wake up all processes sleeping on channel chan.
+// Caller should hold the condition lock.
+void
+wakeup(void *chan)
+{
+  wakeup_n(chan, 1);
+}
+
+// Wake up one process sleeping on chan, for resources that
+// only one waiter can use.  A woken process that leaves some
+// of the resource must pass the wakeup on.
+// Caller should hold the condition lock.
+void
+wakeup_one(void *chan)
+{
+  wakeup_n(chan, 0);
 }
 
 // Kill the process with the given pid.
@@ -594,20 +1805,29 @@ kkill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  // Wake process from sleep().  The sleep queue lock comes
+  // before p->lock, so drop p->lock, take both in order and
+  // check that p is still the same process, asleep on the same
+  // channel; its slot may have been freed and reused meanwhile.
+  while(p->state == SLEEPING){
+    void *chan = p->chan;
+    struct sleepq *sq = sleepq_of(chan);
+    release(&p->lock);
+    acquire(&sq->lock);
     acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
+    if(p->pid != pid){
+      release(&sq->lock);
+      break;
     }
-    release(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan)
+      sleepq_wake(sq, p);
+    release(&sq->lock);
   }
-  return -1;
+  release(&p->lock);
+  return 0;
 }
 
 void
@@ -677,7 +1897,7 @@ procdump(void)
   char *state;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  for(p = allproc; p; p = p->allnext){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
@@ -688,3 +1908,66 @@ procdump(void)
     printf("\n");
   }
 }
+
+// Copy a snapshot of every in-use process to user array dst,
+// at most max entries.  Returns the number of entries, or -1.
+int
+procsnapshot(uint64 dst, int max)
+{
+  struct proc *p;
+  struct procinfo pi;
+  int n = 0;
+
+  for(p = allproc; p && n < max; p = p->allnext){
+    // wait_lock keeps p->parent stable; taken first, as in kwait().
+    acquire(&wait_lock);
+    acquire(&p->lock);
+    if(p->state == UNUSED){
+      release(&p->lock);
+      release(&wait_lock);
+      continue;
+    }
+    pi.pid = p->pid;
+    pi.ppid = p->parent ? p->parent->pid : 0;
+    pi.state = p->state;
+    pi.cpu = p->cpu;
+    pi.level = p->level;
+    pi.nice = p->nice;
+    pi.sz = p->sz;
+    pi.rtime = p->rtime;
+    if(p->state == RUNNING)
+      pi.rtime += r_time() - p->stime;
+    pi.ticks = p->ticks;
+    pi.nswitch = p->nswitch;
+    pi.nfault = p->nfault;
+    safestrcpy(pi.name, p->name, sizeof(pi.name));
+    release(&p->lock);
+    release(&wait_lock);
+
+    if(copyout(myproc()->pagetable, dst + n * sizeof(pi), (char *)&pi, sizeof(pi)) < 0)
+      return -1;
+    n++;
+  }
+  return n;
+}
+
+// Fill in *pc with the calling process's counter totals,
+// or with those of its reaped children.
+void
+procperf(int who, struct perfcount *pc)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  if(who == PERF_CHILDREN){
+    pc->cycles = p->ccycles;
+    pc->instret = p->cinstret;
+    pc->time = p->crtime;
+  } else {
+    // include the current slice; p->lock keeps us on this hart.
+    pc->cycles = p->cycles + (r_cycle() - p->scycle);
+    pc->instret = p->instret + (r_instret() - p->sinstret);
+    pc->time = p->rtime + (r_time() - p->stime);
+  }
+  release(&p->lock);
+}
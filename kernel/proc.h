@@ -34,6 +34,12 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler
   int noff;                   // push_off nesting
   int intena;                 // interrupt enabled before push_off?
+  volatile int idle;          // scheduler() found nothing to run
+  volatile int resched;       // an IPI asks the current process to yield
+  volatile int inuser;        // in user mode: prepare_return() to usertrap()
+  volatile uint64 uentries;   // usertrap()s taken
+  uint64 kstackgen;           // kernel stacks mapped as of last sfence
+  struct proc *fpowner;       // whose F/V state the registers hold, maybe
 };
 
 extern struct cpu cpus[NCPU];
@@ -104,18 +110,74 @@ struct proc {
   int xstate;
   int pid;
 
-  // parent process
-  struct proc *parent;
-
-  // Private state, lock not required
+  // accounting, p->lock required
+  int cpu;                 // hart running this process, -1 if none
+  uint64 stime;            // r_time() when last switched in
+  uint64 rtime;            // accumulated time on a CPU
+  uint64 ticks;            // scheduling ticks taken while running (by its hart)
+  uint64 nswitch;          // times switched in by scheduler()
+  uint64 nfault;           // pages lazily mapped by vmfault() (by itself)
+  uint64 scycle;           // r_cycle() when last switched in
+  uint64 sinstret;         // r_instret() when last switched in
+  uint64 cycles;           // accumulated cycles on a CPU
+  uint64 instret;          // accumulated instructions retired
+
+  // run queue, p->lock and the run queue's lock required
+  struct proc *rqnext;     // next on the run queue, while RUNNABLE
+  int lastcpu;             // hart it last ran on, -1 if never
+  uint64 cpumask;          // harts it may run on, bit per hart
+
+  // sleep queue, p->lock and the sleep queue's lock required
+  struct proc *sqnext;     // next and previous sleeper while SLEEPING
+  struct proc *sqprev;
+
+  // MLFQ priority; p->lock required
+  int level;               // 0..NMLFQ-1, 0 runs first
+  int quantum;             // ticks left before demotion
+  int nice;                // 0..NICE_MAX; larger keeps it at lower levels
+  int boostepoch;          // mlfq_boost()s applied to level
+
+  // EDF class (see edfset()); p->lock required, or the EDF lock
+  // while it is queued.  Times in time CSR units.
+  uint64 edf_period;       // 0 if not an EDF process
+  uint64 edf_budget;       // time allowed per period
+  uint64 edf_deadline;     // end of the current period
+  uint64 edf_used;         // time used in the current period
+  uint64 edf_util;         // budget/period in parts per million; EDF lock
+
+  // totals of reaped children, written only by this process in kwait()
+  uint64 crtime;
+  uint64 ccycles;
+  uint64 cinstret;
+
+  // wait_lock must be held when using these:
+  struct proc *parent;     // parent process
+  struct proc *children;   // this process's children, newest first
+  struct proc *sibling;    // next child of parent
+
+  // process table (see allproc in proc.c)
+  struct proc *allnext;    // every struct proc; never changes once set
+  struct proc *freenext;   // free list; ptable lock
+  struct proc *pidnext;    // pid hash chain; pid_lock
+  int slot;                // 0..NPROC-1; fixed
+  // Private state, lock not required; but wait_lock is needed to
+  // change pagetable or sz once clone() may share them.
   uint64 kstack;           // address of kernel stack
   uint64 sz;               // process memory size
-  pagetable_t pagetable;   // user page table
+  pagetable_t pagetable;   // user page table, maybe shared with clone()d threads
   struct trapframe *trapframe;
+  uint64 tfva;             // user address trapframe is mapped at
+  void *fpstate;           // F/V registers (fpu.c); 0 until first used
+  int fpcpu;               // hart whose registers hold them, or -1
+  uint64 fpstatus;         // sstatus FS/VS bits for them
   struct context context;
   struct file *ofile[NOFILE];
   struct inode *cwd;       // current directory
   char name[16];           // debugging
+
+  // kernel threads (kthread_create()); 0 for user processes
+  void (*kfn)(void*);
+  void *karg;
 };
 
 #endif // PROC_H
@@ -0,0 +1,29 @@
+#ifndef PROCINFO_H
+#define PROCINFO_H
+
+// One process in a procinfo() snapshot.
+
+// values of state, in the order of enum procstate (proc.h)
+#define PI_UNUSED    0
+#define PI_USED      1
+#define PI_SLEEPING  2
+#define PI_RUNNABLE  3
+#define PI_RUNNING   4
+#define PI_ZOMBIE    5
+
+struct procinfo {
+  int    pid;
+  int    ppid;        // 0 if none
+  int    state;       // PI_*
+  int    cpu;         // hart running it, -1 if not running
+  int    level;       // scheduler priority level, 0 highest
+  int    nice;        // see nice()
+  uint64 sz;          // user memory, bytes
+  uint64 rtime;       // time on a CPU, time CSR units (TIMEBASE Hz)
+  uint64 ticks;       // scheduling ticks taken while running
+  uint64 nswitch;     // times the scheduler switched to it
+  uint64 nfault;      // pages lazily mapped on page faults
+  char   name[16];
+};
+
+#endif // PROCINFO_H
@@ -0,0 +1,123 @@
+// kernel/prof.c
+// Timer-interrupt sampling profiler.
+//
+// While profiling is on, clockintr() asks prof_tick() for the next
+// sample deadline on this hart and programs the timer for whichever of
+// that and the next scheduling tick comes first.  When a sample is due
+// prof_tick() records the interrupted pc, which is still in sepc for
+// both usertrap() and kerneltrap(), together with the hart and the
+// current process.
+//
+// Each hart appends to its own buffer with interrupts off, so the
+// sample path takes no lock.  A buffer stops filling when it is full.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "prof.h"
+
+struct prof_cpu {
+  uint64 due;        // time of this hart's next sample
+  int n;             // samples recorded
+  int dropped;       // samples lost because the buffer was full
+  struct prof_sample s[PROF_NSAMPLE];
+} __attribute__((aligned(64)));
+
+static struct prof_cpu profcpu[NCPU];
+static uint64 prof_interval;   // time units between samples; 0 = off
+
+// Called from clockintr() with interrupts off.
+// Returns the time of this hart's next sample, or 0 if not profiling.
+uint64
+prof_tick(uint64 now)
+{
+  uint64 interval = prof_interval;
+  struct prof_cpu *pc;
+  struct proc *p;
+
+  if(interval == 0)
+    return 0;
+
+  pc = &profcpu[cpuid()];
+  if(now < pc->due)
+    return pc->due;
+  pc->due = now + interval;
+
+  if(pc->n >= PROF_NSAMPLE){
+    pc->dropped++;
+    return pc->due;
+  }
+
+  struct prof_sample *s = &pc->s[pc->n];
+  s->pc = r_sepc();
+  s->user = (r_sstatus() & SSTATUS_SPP) == 0;
+  s->cpu = cpuid();
+  p = mycpu()->proc;
+  if(p){
+    s->pid = p->pid;
+    safestrcpy(s->name, p->name, sizeof(s->name));
+  } else {
+    s->pid = 0;
+    safestrcpy(s->name, "idle", sizeof(s->name));
+  }
+  __sync_synchronize();
+  pc->n++;
+
+  return pc->due;
+}
+
+// Start sampling at hz samples per second per hart, discarding
+// earlier samples; hz == 0 stops and returns the number of samples
+// dropped for lack of space.  Harts pick up a new rate at their
+// next timer interrupt.
+int
+prof_start(int hz)
+{
+  if(hz < 0 || hz > PROF_MAXHZ)
+    return -1;
+
+  prof_interval = 0;
+  __sync_synchronize();
+  if(hz == 0){
+    int dropped = 0;
+    for(int i = 0; i < NCPU; i++)
+      dropped += profcpu[i].dropped;
+    return dropped;
+  }
+
+  for(int i = 0; i < NCPU; i++){
+    profcpu[i].due = 0;
+    profcpu[i].n = 0;
+    profcpu[i].dropped = 0;
+  }
+  __sync_synchronize();
+  prof_interval = TIMEBASE / hz;
+  return 0;
+}
+
+// Copy up to max samples, hart by hart, to user address dst.
+// Returns the number copied, or -1.
+int
+prof_copyout(uint64 dst, int max)
+{
+  struct proc *p = myproc();
+  int total = 0;
+
+  for(int i = 0; i < NCPU && total < max; i++){
+    int n = profcpu[i].n;
+    __sync_synchronize();
+    if(n > max - total)
+      n = max - total;
+    if(n == 0)
+      continue;
+    if(copyout(p->pagetable, dst + total * sizeof(struct prof_sample),
+               (char *)profcpu[i].s, n * sizeof(struct prof_sample)) < 0)
+      return -1;
+    total += n;
+  }
+  return total;
+}
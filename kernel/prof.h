@@ -0,0 +1,18 @@
+#ifndef PROF_H
+#define PROF_H
+
+// Timer-interrupt sampling profiler records, copied out by
+// profdump() and printed by user/prof.c for tools/profsym.py.
+
+#define PROF_NSAMPLE  512     // samples kept per hart per run
+#define PROF_MAXHZ    10000   // highest sampling rate profctl() accepts
+
+struct prof_sample {
+  uint64 pc;        // interrupted sepc
+  int    pid;       // current process, 0 if the hart was idle
+  uint16 cpu;       // hart that took the sample
+  uint16 user;      // 1 if pc is a user address
+  char   name[16];  // p->name, for finding the program's .sym file
+};
+
+#endif // PROF_H
@@ -25,6 +25,15 @@ r_mhartid(void)
 #define MSTATUS_MPP_S (1L << 11)
 #define MSTATUS_MPP_U (0L << 11)
 
+// ISA extensions, one bit per letter ('A' is bit 0)
+static inline uint64
+r_misa(void)
+{
+  uint64 x;
+  asm volatile("csrr %0, misa" : "=r" (x));
+  return x;
+}
+
 static inline uint64
 r_mstatus(void)
 {
@@ -52,6 +61,14 @@ w_mepc(uint64 x)
 #define SSTATUS_SPP (1L << 8)  // Previous mode, 1=Supervisor, 0=User
 #define SSTATUS_SPIE (1L << 5) // Supervisor Previous Interrupt Enable
 #define SSTATUS_UPIE (1L << 4) // User Previous Interrupt Enable
+#define SSTATUS_FS (3L << 13)  // floating-point state: off, initial, clean, dirty
+#define SSTATUS_FS_INITIAL (1L << 13)
+#define SSTATUS_FS_CLEAN (2L << 13)
+#define SSTATUS_FS_DIRTY (3L << 13)
+#define SSTATUS_VS (3L << 9)   // vector state, encoded like FS
+#define SSTATUS_VS_INITIAL (1L << 9)
+#define SSTATUS_VS_CLEAN (2L << 9)
+#define SSTATUS_VS_DIRTY (3L << 9)
 #define SSTATUS_SIE (1L << 1)  // Supervisor Interrupt Enable
 #define SSTATUS_UIE (1L << 0)  // User Interrupt Enable
 
@@ -69,6 +86,12 @@ w_sstatus(uint64 x)
   asm volatile("csrw sstatus, %0" : : "r" (x));
 }
 
+static inline void
+w_sscratch(uint64 x)
+{
+  asm volatile("csrw sscratch, %0" : : "r" (x));
+}
+
 // Supervisor Interrupt Pending
 static inline uint64
 r_sip(void)
@@ -84,9 +107,12 @@ w_sip(uint64 x)
   asm volatile("csrw sip, %0" : : "r" (x));
 }
 
+#define SIP_SSIP (1L << 1) // software interrupt pending
+
 // Supervisor Interrupt Enable
 #define SIE_SEIE (1L << 9) // external
 #define SIE_STIE (1L << 5) // timer
+#define SIE_SSIE (1L << 1) // software
 
 static inline uint64
 r_sie(void)
@@ -104,6 +130,7 @@ w_sie(uint64 x)
 
 // Machine-mode Interrupt Enable
 #define MIE_STIE (1L << 5)  // supervisor timer
+#define MIE_MSIE (1L << 3)  // machine software
 static inline uint64
 r_mie(void)
 {
@@ -273,6 +300,40 @@ r_mcounteren(void)
   return x;
 }
 
+// Machine-mode interrupt vector
+static inline void
+w_mtvec(uint64 x)
+{
+  asm volatile("csrw mtvec, %0" : : "r" (x));
+}
+
+// Machine-mode scratch register, for mvec
+static inline void
+w_mscratch(uint64 x)
+{
+  asm volatile("csrw mscratch, %0" : : "r" (x));
+}
+
+// Supervisor Counter-Enable: which counters user mode may read.
+static inline void
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren(void)
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x));
+  return x;
+}
+
+// counter-enable bits
+#define COUNTEREN_CY (1L << 0)   // cycle
+#define COUNTEREN_TM (1L << 1)   // time
+#define COUNTEREN_IR (1L << 2)   // instret
+
 // Time CSR (cycle/time)
 static inline uint64
 r_time(void)
@@ -282,6 +343,24 @@ r_time(void)
   return x;
 }
 
+// cycles executed by this hart
+static inline uint64
+r_cycle(void)
+{
+  uint64 x;
+  asm volatile("csrr %0, cycle" : "=r" (x));
+  return x;
+}
+
+// instructions retired by this hart
+static inline uint64
+r_instret(void)
+{
+  uint64 x;
+  asm volatile("csrr %0, instret" : "=r" (x));
+  return x;
+}
+
 // Interrupt helpers
 static inline void
 intr_on(void)
@@ -358,6 +437,7 @@ typedef uint64 *pagetable_t; // 512 PTEs
 #define PTE_W (1L << 2)
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // user accessible
+#define PTE_COW (1L << 8) // RSW bit: copy-on-write, write enabled on a private copy
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)(pa)) >> 12) << 10)
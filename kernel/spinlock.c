@@ -7,6 +7,50 @@
 #include "riscv.h"
 #include "proc.h"
 #include "defs.h"
+#include "lockstat.h"
+
+// Lock statistics, kept per hart so that counting an acquisition
+// never bounces a cache line between harts, and keyed by lock name
+// (all "proc" locks share one entry).  Slot 0 collects locks that
+// were never initlock()ed or that arrived after the table filled.
+struct lockstat_ent {
+  uint64 acquire;
+  uint64 contended;
+  uint64 spin;
+  uint64 hold;
+  uint64 maxhold;
+};
+
+static struct {
+  struct lockstat_ent e[NLOCKSTAT];
+} __attribute__((aligned(64))) lockstats[NCPU];
+
+static char *locknames[NLOCKSTAT] = { "(other)" };
+static int nlocknames = 1;
+static uint locknames_busy;   // raw flag: acquire() can't count itself
+
+// Find or add the statistics slot for a lock name.
+static int
+lockstat_id(char *name)
+{
+  int id;
+
+  push_off();
+  while(__sync_lock_test_and_set(&locknames_busy, 1) != 0)
+    ;
+  for(id = 1; id < nlocknames; id++)
+    if(locknames[id] == name || strncmp(locknames[id], name, 16) == 0)
+      break;
+  if(id == nlocknames){
+    if(nlocknames < NLOCKSTAT)
+      locknames[nlocknames++] = name;
+    else
+      id = 0;
+  }
+  __sync_lock_release(&locknames_busy);
+  pop_off();
+  return id;
+}
 
 void
 initlock(struct spinlock *lk, char *name)
@@ -14,6 +58,8 @@ initlock(struct spinlock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->cpu = 0;
+  lk->statid = lockstat_id(name);
+  lk->acqtime = 0;
 }
 
 // Acquire the lock.
@@ -29,8 +75,18 @@ acquire(struct spinlock *lk)
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  //
+  // Only time the spin if the first attempt fails, so an
+  // uncontended acquire costs one extra time CSR read.
+  uint64 spin = 0;
+  int contended = 0;
+  if(__sync_lock_test_and_set(&lk->locked, 1) != 0){
+    uint64 t0 = r_time();
+    while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+      ;
+    spin = r_time() - t0;
+    contended = 1;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +96,14 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+  lk->acqtime = r_time();
+
+  struct lockstat_ent *e = &lockstats[cpuid()].e[lk->statid];
+  e->acquire++;
+  if(contended){
+    e->contended++;
+    e->spin += spin;
+  }
 }
 
 // Release the lock.
@@ -49,6 +113,13 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  // a lock is released on the hart that acquired it.
+  uint64 held = r_time() - lk->acqtime;
+  struct lockstat_ent *e = &lockstats[cpuid()].e[lk->statid];
+  e->hold += held;
+  if(held > e->maxhold)
+    e->maxhold = held;
+
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -111,3 +182,40 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// Sum the per-hart lock statistics into user array dst of up to max
+// entries, one per lock name.  With LS_RESET, zero the counters
+// afterwards.  Returns the number of entries, or -1.
+int
+lockstat_copyout(uint64 dst, int max, int flags)
+{
+  struct proc *p = myproc();
+  struct lockstat ls;
+  int n = 0;
+
+  for(int id = 0; id < nlocknames && n < max; id++){
+    memset(&ls, 0, sizeof(ls));
+    safestrcpy(ls.name, locknames[id], sizeof(ls.name));
+    for(int c = 0; c < NCPU; c++){
+      struct lockstat_ent *e = &lockstats[c].e[id];
+      ls.acquire += e->acquire;
+      ls.contended += e->contended;
+      ls.spin += e->spin;
+      ls.hold += e->hold;
+      if(e->maxhold > ls.maxhold)
+        ls.maxhold = e->maxhold;
+    }
+    if(ls.acquire == 0)
+      continue;
+    if(copyout(p->pagetable, dst + n * sizeof(ls), (char *)&ls, sizeof(ls)) < 0)
+      return -1;
+    n++;
+  }
+
+  // racy against harts updating their counters, which at worst
+  // keeps a few counts from before the reset.
+  if(flags & LS_RESET)
+    memset(lockstats, 0, sizeof(lockstats));
+
+  return n;
+}
@@ -12,6 +12,10 @@ struct spinlock {
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The CPU holding the lock
+
+  // For lockstat:
+  int statid;        // index of name in the lock statistics
+  uint64 acqtime;    // r_time() when acquired
 };
 
 #endif // SPINLOCK_H
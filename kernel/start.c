@@ -3,13 +3,20 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "defs.h"
+#include "hwcap.h"
 
 void main();
 void timerinit();
+void ipiinit();
+extern void mvec();
+extern uint64 hwcap;
 
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
+// scratch area for mvec in kernelvec.S, one per CPU.
+uint64 mscratch0[NCPU][4];
+
 // entry.S jumps here in machine mode on stack0.
 void
 start()
@@ -30,7 +37,7 @@ start()
   // delegate all interrupts and exceptions to supervisor mode.
   w_medeleg(0xffff);
   w_mideleg(0xffff);
-  w_sie(r_sie() | SIE_SEIE | SIE_STIE);
+  w_sie(r_sie() | SIE_SEIE | SIE_STIE | SIE_SSIE);
 
   // configure Physical Memory Protection to give supervisor mode
   // access to all of physical memory.
@@ -40,6 +47,15 @@ start()
   // ask for clock interrupts.
   timerinit();
 
+  // let other harts interrupt this one.
+  ipiinit();
+
+  // which of F, D and V user code can have (see fpu.c).
+  uint64 misa = r_misa();
+  hwcap = ((misa & (1L << ('F'-'A'))) ? HWCAP_F : 0) |
+          ((misa & (1L << ('D'-'A'))) ? HWCAP_D : 0) |
+          ((misa & (1L << ('V'-'A'))) ? HWCAP_V : 0);
+
   // keep each CPU's hartid in its tp register, for cpuid().
   int id = r_mhartid();
   w_tp(id);
@@ -58,9 +74,29 @@ timerinit()
   // enable the sstc extension (i.e. stimecmp).
   w_menvcfg(r_menvcfg() | (1L << 63)); 
   
-  // allow supervisor to use stimecmp and time.
-  w_mcounteren(r_mcounteren() | 2);
+  // allow supervisor to use stimecmp and time, and to read
+  // cycle, instret and whatever hpm counters this hart has
+  // (mcounteren is WARL, so bits for missing counters stay 0).
+  w_mcounteren(0xffffffff);
+
+  // and let user code read cycle, time and instret directly.
+  w_scounteren(COUNTEREN_CY | COUNTEREN_TM | COUNTEREN_IR);
   
   // ask for the very first timer interrupt.
-  w_stimecmp(r_time() + 1000000);
+  w_stimecmp(r_time() + TICKINTERVAL);
+}
+
+// arrange for CLINT software interrupts (IPIs) to reach
+// supervisor mode.  the machine-mode software interrupt
+// cannot be delegated, so mvec in kernelvec.S turns it into
+// a supervisor software interrupt.
+void
+ipiinit()
+{
+  int id = r_mhartid();
+
+  mscratch0[id][2] = CLINT_MSIP(id);
+  w_mscratch((uint64)&mscratch0[id][0]);
+  w_mtvec((uint64)mvec);
+  w_mie(r_mie() | MIE_MSIE);
 }
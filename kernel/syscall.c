@@ -7,6 +7,7 @@
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
+#include "sysstat.h"
 
 // ----------------------------------------------------
 // Declarations for custom syscalls
@@ -100,6 +101,25 @@ extern uint64 sys_set_speed(void);
 extern uint64 sys_view_anim(void);
 extern uint64 sys_fb_write(void);
 extern uint64 sys_fb_clear(void);
+extern uint64 sys_debuggraph(void);
+extern uint64 sys_profctl(void);
+extern uint64 sys_profdump(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_sysstat(void);
+extern uint64 sys_procinfo(void);
+extern uint64 sys_memstat(void);
+extern uint64 sys_iostat(void);
+extern uint64 sys_dmesg(void);
+extern uint64 sys_getperf(void);
+extern uint64 sys_nice(void);
+extern uint64 sys_setaffinity(void);
+extern uint64 sys_getaffinity(void);
+extern uint64 sys_edfset(void);
+extern uint64 sys_edfyield(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_hwcap(void);
 
 // ----------------------------------------------------
 // Mapping: syscall number -> handler
@@ -134,8 +154,76 @@ static uint64 (*syscalls[])(void) = {
   [SYS_view_anim]  = sys_view_anim,
   [SYS_fb_write]   = sys_fb_write,
   [SYS_fb_clear]   = sys_fb_clear,
+  [SYS_debuggraph] = sys_debuggraph,
+  [SYS_profctl]    = sys_profctl,
+  [SYS_profdump]   = sys_profdump,
+  [SYS_lockstat]   = sys_lockstat,
+  [SYS_sysstat]    = sys_sysstat,
+  [SYS_procinfo]   = sys_procinfo,
+  [SYS_memstat]    = sys_memstat,
+  [SYS_iostat]     = sys_iostat,
+  [SYS_dmesg]      = sys_dmesg,
+  [SYS_getperf]    = sys_getperf,
+  [SYS_nice]       = sys_nice,
+  [SYS_setaffinity] = sys_setaffinity,
+  [SYS_getaffinity] = sys_getaffinity,
+  [SYS_edfset]     = sys_edfset,
+  [SYS_edfyield]   = sys_edfyield,
+  [SYS_clone]      = sys_clone,
+  [SYS_join]       = sys_join,
+  [SYS_nanosleep]  = sys_nanosleep,
+  [SYS_hwcap]      = sys_hwcap,
 };
 
+// ----------------------------------------------------
+// Per-syscall latency statistics, one table per hart so that
+// recording a call never touches another hart's cache lines.
+// A call is charged to the hart it returns on.
+// ----------------------------------------------------
+static struct {
+  struct sysstat s[SYSSTAT_NCALL];
+} __attribute__((aligned(64))) sysstats[NCPU];
+
+static void
+sysstat_record(int num, uint64 dt)
+{
+  push_off();
+  struct sysstat *s = &sysstats[cpuid()].s[num];
+  s->count++;
+  s->total += dt;
+  s->hist[hist_bucket(dt)]++;
+  pop_off();
+}
+
+// Sum the per-hart tables for syscalls [0, max) into user array dst;
+// with SS_RESET, zero them afterwards.  Returns entries copied, or -1.
+int
+sysstat_copyout(uint64 dst, int max, int flags)
+{
+  struct proc *p = myproc();
+  struct sysstat s;
+
+  if (max > SYSSTAT_NCALL)
+    max = SYSSTAT_NCALL;
+  for (int num = 0; num < max; num++) {
+    memset(&s, 0, sizeof(s));
+    for (int c = 0; c < NCPU; c++) {
+      struct sysstat *cs = &sysstats[c].s[num];
+      s.count += cs->count;
+      s.total += cs->total;
+      for (int b = 0; b < NHIST; b++)
+        s.hist[b] += cs->hist[b];
+    }
+    if (copyout(p->pagetable, dst + num * sizeof(s), (char *)&s, sizeof(s)) < 0)
+      return -1;
+  }
+  // racy against harts updating their tables, which at worst
+  // keeps a few counts from before the reset.
+  if (flags & SS_RESET)
+    memset(sysstats, 0, sizeof(sysstats));
+  return max;
+}
+
 // ----------------------------------------------------
 // syscall() — call the handler for the syscall number
 // ----------------------------------------------------
@@ -147,7 +235,10 @@ syscall(void)
 
   num = p->trapframe->a7;
   if (num > 0 && num < (int)NELEM(syscalls) && syscalls[num]) {
+    uint64 t0 = r_time();
     p->trapframe->a0 = syscalls[num]();  // call it
+    if (num < SYSSTAT_NCALL)
+      sysstat_record(num, r_time() - t0);
   } else {
     printf("%d %s: unknown sys call %d\n", p->pid, p->name, num);
     p->trapframe->a0 = -1;
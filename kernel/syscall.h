@@ -28,6 +28,25 @@
 #define SYS_view_anim  27
 #define SYS_fb_write   28
 #define SYS_fb_clear   29
+#define SYS_debuggraph 30
+#define SYS_profctl    31
+#define SYS_profdump   32
+#define SYS_lockstat   33
+#define SYS_sysstat    34
+#define SYS_procinfo   35
+#define SYS_memstat    36
+#define SYS_iostat     37
+#define SYS_dmesg      38
+#define SYS_getperf    39
+#define SYS_nice       40
+#define SYS_setaffinity 41
+#define SYS_getaffinity 42
+#define SYS_edfset     43
+#define SYS_edfyield   44
+#define SYS_clone      45
+#define SYS_join       46
+#define SYS_nanosleep  47
+#define SYS_hwcap      48
 
 
 
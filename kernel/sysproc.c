@@ -11,7 +11,11 @@
 #include "animation.h"
 #include "fb.h"
 #include "debug_graph.h"
-extern struct proc proc[NPROC];
+#include "memstat.h"
+#include "iostat.h"
+#include "perf.h"
+extern struct proc *allproc;
+extern uint64 hwcap;
 
 // ====================================================
 // GLOBALS for animation
@@ -131,15 +135,8 @@ sys_kinfo(void)
 
   printf("kernel: kinfo() called by pid %d\n", curproc->pid);
 
-  void *mem = kalloc();
-  if(mem == 0){
-    printf("kernel: memory allocation failed!\n");
-  } else {
-    printf("kernel: allocated one page at %p\n", mem);
-  }
-
   printf("PID\tSTATE\t\tNAME\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  for(p = allproc; p; p = p->allnext){
     if(p->state == UNUSED)
       continue;
 
@@ -164,13 +161,14 @@ sys_kinfo(void)
 uint64
 sys_sbrk(void)
 {
-  int addr;
+  uint64 addr;
   int n;
 
   argint(0, &n);
-  addr = myproc()->sz;
 
-  if (growproc(n) < 0)
+  // growproc() reads the old size, as a clone()d thread
+  // may be growing the same memory.
+  if (growproc(n, &addr) < 0)
     return -1;
 
   return addr;
@@ -189,22 +187,13 @@ uint64 sys_uptime(void){ uint xticks; acquire(&tickslock); xticks=ticks; release
 
 uint64 sys_pause(void){
   int n; 
-  uint ticks0;
 
   argint(0,&n);
   if(n < 0) n = 0;
 
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < (uint)n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  // n ticks of TICKINTERVAL, timed by an hrtimer rather than
+  // by rechecking on every tick.
+  return hrtimer_sleep(r_time() + (uint64)n * TICKINTERVAL);
 }
 uint64
 sys_debuggraph(void)
@@ -213,3 +202,275 @@ sys_debuggraph(void)
     return 0;
 }
 
+// ====================================================
+// syscall: profctl(int hz)
+// start sampling at hz per hart (discarding old samples),
+// or stop with hz == 0, returning the number of dropped samples.
+// ====================================================
+uint64
+sys_profctl(void)
+{
+  int hz;
+  argint(0, &hz);
+  return prof_start(hz);
+}
+
+// ====================================================
+// syscall: profdump(struct prof_sample *buf, int max)
+// ====================================================
+uint64
+sys_profdump(void)
+{
+  uint64 buf;
+  int max;
+  argaddr(0, &buf);
+  argint(1, &max);
+  if (max < 0)
+    return -1;
+  return prof_copyout(buf, max);
+}
+
+// ====================================================
+// syscall: lockstat(struct lockstat *buf, int max, int flags)
+// ====================================================
+uint64
+sys_lockstat(void)
+{
+  uint64 buf;
+  int max, flags;
+  argaddr(0, &buf);
+  argint(1, &max);
+  argint(2, &flags);
+  if (max < 0)
+    return -1;
+  return lockstat_copyout(buf, max, flags);
+}
+
+// ====================================================
+// syscall: sysstat(struct sysstat *buf, int max, int flags)
+// ====================================================
+uint64
+sys_sysstat(void)
+{
+  uint64 buf;
+  int max, flags;
+  argaddr(0, &buf);
+  argint(1, &max);
+  argint(2, &flags);
+  if (max < 0)
+    return -1;
+  return sysstat_copyout(buf, max, flags);
+}
+
+// ====================================================
+// syscall: procinfo(struct procinfo *buf, int max)
+// structured replacement for kinfo()'s printed table.
+// ====================================================
+uint64
+sys_procinfo(void)
+{
+  uint64 buf;
+  int max;
+  argaddr(0, &buf);
+  argint(1, &max);
+  if (max < 0)
+    return -1;
+  return procsnapshot(buf, max);
+}
+
+// ====================================================
+// syscall: memstat(struct memstat *ms)
+// ====================================================
+uint64
+sys_memstat(void)
+{
+  uint64 addr;
+  struct memstat ms;
+
+  argaddr(0, &addr);
+  kmemstat(&ms);
+  ms.faults = nvmfault;
+  ms.cowcopies = ncowcopy;
+  if (copyout(myproc()->pagetable, addr, (char *)&ms, sizeof(ms)) < 0)
+    return -1;
+  return 0;
+}
+
+// ====================================================
+// syscall: dmesg(char *buf, int n)
+// copies the most recent n bytes of kernel log
+// ====================================================
+uint64
+sys_dmesg(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  if (n < 0)
+    return -1;
+  return klog_read(addr, n);
+}
+
+// ====================================================
+// syscall: iostat(struct iostat *st, int flags)
+// ====================================================
+uint64
+sys_iostat(void)
+{
+  uint64 addr;
+  int flags;
+
+  argaddr(0, &addr);
+  argint(1, &flags);
+  // a racy copy: counters are only ever incremented.
+  if (copyout(myproc()->pagetable, addr, (char *)&iostats, sizeof(iostats)) < 0)
+    return -1;
+  // racy too: an update during the memset may survive it.
+  if (flags & IO_RESET)
+    memset(&iostats, 0, sizeof(iostats));
+  return 0;
+}
+
+// ====================================================
+// syscall: getperf(int who, struct perfcount *pc)
+// who is PERF_SELF or PERF_CHILDREN
+// ====================================================
+uint64
+sys_getperf(void)
+{
+  int who;
+  uint64 addr;
+  struct perfcount pc;
+
+  argint(0, &who);
+  argaddr(1, &addr);
+  if (who != PERF_SELF && who != PERF_CHILDREN)
+    return -1;
+  procperf(who, &pc);
+  if (copyout(myproc()->pagetable, addr, (char *)&pc, sizeof(pc)) < 0)
+    return -1;
+  return 0;
+}
+
+// ====================================================
+// syscall: nice(int inc)
+// returns the new nice value
+// ====================================================
+uint64
+sys_nice(void)
+{
+  int inc;
+
+  argint(0, &inc);
+  return setnice(inc);
+}
+
+// ====================================================
+// syscall: setaffinity(int pid, int mask)
+// pid 0 means the caller; mask has a bit per hart
+// ====================================================
+uint64
+sys_setaffinity(void)
+{
+  int pid, mask;
+
+  argint(0, &pid);
+  argint(1, &mask);
+  return setaffinity(pid, (uint)mask);
+}
+
+// ====================================================
+// syscall: getaffinity(int pid)
+// returns the mask, or -1
+// ====================================================
+uint64
+sys_getaffinity(void)
+{
+  int pid;
+
+  argint(0, &pid);
+  return getaffinity(pid);
+}
+
+// ====================================================
+// syscall: edfset(int period_us, int budget_us)
+// period 0 returns the caller to normal scheduling
+// ====================================================
+uint64
+sys_edfset(void)
+{
+  int period, budget;
+
+  argint(0, &period);
+  argint(1, &budget);
+  return edfset(period, budget);
+}
+
+// ====================================================
+// syscall: edfyield(void)
+// returns 1 if this period's work finished late
+// ====================================================
+uint64
+sys_edfyield(void)
+{
+  return edfyield();
+}
+
+// ====================================================
+// syscall: clone(void (*fn)(void*), void *arg, void *stack)
+// a thread sharing the caller's memory; stack is its top
+// ====================================================
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  argaddr(0, &fn);
+  argaddr(1, &arg);
+  argaddr(2, &stack);
+  return kclone(fn, arg, stack);
+}
+
+// ====================================================
+// syscall: join(int *status)
+// reap a clone()d thread, like wait()
+// ====================================================
+uint64
+sys_join(void)
+{
+  uint64 p;
+
+  argaddr(0, &p);
+  return kjoin(p);
+}
+
+// ====================================================
+// syscall: nanosleep(uint64 ns)
+// resolution is the time CSR's, 100 ns on qemu
+// ====================================================
+uint64
+sys_nanosleep(void)
+{
+  uint64 ns, now, t;
+
+  argaddr(0, &ns);
+  // round up, so we never wake early, without overflowing;
+  // a deadline past the end of time saturates.
+  t = ns / (1000000000 / TIMEBASE) + (ns % (1000000000 / TIMEBASE) != 0);
+  now = r_time();
+  if(t > ~0UL - now)
+    return hrtimer_sleep(~0UL);
+  return hrtimer_sleep(now + t);
+}
+
+// ====================================================
+// syscall: hwcap(void)
+// HWCAP_* extensions user code may use (kernel/hwcap.h)
+// ====================================================
+uint64
+sys_hwcap(void)
+{
+  return hwcap;
+}
@@ -0,0 +1,19 @@
+#ifndef SYSSTAT_H
+#define SYSSTAT_H
+
+#include "hist.h"
+
+// Per-syscall latency statistics, indexed by syscall number and
+// copied out by the sysstat() system call.
+// Latencies are in units of the time CSR (TIMEBASE Hz).
+
+#define SYSSTAT_NCALL  64   // syscall numbers tracked (SYS_* < this)
+#define SS_RESET       1    // sysstat() flag: zero counters after copying
+
+struct sysstat {
+  uint64 count;           // completed calls
+  uint64 total;           // summed latency
+  uint32 hist[NHIST];     // log2 latency histogram
+};
+
+#endif // SYSSTAT_H
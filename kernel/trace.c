@@ -0,0 +1,167 @@
+// kernel/trace.c
+// Per-hart event tracing and the /dev/trace device.
+//
+// Each hart owns a ring of struct trace_event.  trace_record() is the
+// only writer of its hart's ring and runs with interrupts off, so the
+// record path needs no lock: it fills the slot, then publishes it by
+// bumping head.  Old events are overwritten when the ring wraps.
+//
+// Readers of /dev/trace consume each ring from its tail.  A reader
+// copies an event and then re-checks head; if the writer may have
+// lapped the slot in the meantime the copy is discarded and reported
+// as lost, so a reader never blocks the writer.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "file.h"
+#include "trace.h"
+
+struct trace_ring {
+  uint64 head;     // events ever recorded; written only by the owning hart
+  uint64 tail;     // next event for /dev/trace; trace_rdlock
+  struct trace_event ev[TRACE_NEVENT];
+} __attribute__((aligned(64)));
+
+static struct trace_ring rings[NCPU];
+
+// serializes readers of /dev/trace; never taken by trace_record().
+static struct spinlock trace_rdlock;
+
+// Record one event in this hart's ring.
+// Safe from any context, including interrupt handlers.
+void
+trace_record(int type, uint64 arg0, uint64 arg1)
+{
+  struct trace_ring *r;
+  struct trace_event *e;
+  struct proc *p;
+
+  push_off();
+  r = &rings[cpuid()];
+  e = &r->ev[r->head % TRACE_NEVENT];
+  e->ts = r_time();
+  e->type = type;
+  e->cpu = cpuid();
+  p = mycpu()->proc;
+  e->pid = p ? p->pid : 0;
+  e->arg0 = arg0;
+  e->arg1 = arg1;
+
+  // make the event visible before publishing it.
+  __sync_synchronize();
+  r->head++;
+  pop_off();
+}
+
+// Copy the most recent events (up to max) of the given type
+// from every ring into out[], without consuming them.
+// Returns the number copied; order is per hart, not global.
+int
+trace_snapshot(int type, struct trace_event *out, int max)
+{
+  int n = 0;
+
+  for(int c = 0; c < NCPU && n < max; c++){
+    struct trace_ring *r = &rings[c];
+    uint64 head = r->head;
+    uint64 first = head > TRACE_NEVENT ? head - TRACE_NEVENT : 0;
+
+    __sync_synchronize();
+    for(uint64 i = head; i > first && n < max; i--){
+      struct trace_event e = r->ev[(i - 1) % TRACE_NEVENT];
+      __sync_synchronize();
+      if(r->head - (i - 1) >= TRACE_NEVENT)
+        break; // overwritten while we looked
+      if(e.type == type)
+        out[n++] = e;
+    }
+  }
+  return n;
+}
+
+// Take up to max events from the rings into out[], advancing tails.
+// Caller holds trace_rdlock.
+static int
+trace_take(struct trace_event *out, int max)
+{
+  int n = 0;
+
+  for(int c = 0; c < NCPU && n < max; c++){
+    struct trace_ring *r = &rings[c];
+
+    while(n < max){
+      uint64 head = r->head;
+      __sync_synchronize();
+      if(r->tail == head)
+        break;
+
+      if(head - r->tail >= TRACE_NEVENT){
+        // the writer lapped us, or may be rewriting the oldest slot;
+        // skip ahead and say how much was lost.
+        uint64 lost = head - TRACE_NEVENT + 1 - r->tail;
+        r->tail = head - TRACE_NEVENT + 1;
+        out[n].ts = r_time();
+        out[n].type = TR_LOST;
+        out[n].cpu = c;
+        out[n].pid = 0;
+        out[n].arg0 = lost;
+        out[n].arg1 = 0;
+        n++;
+        continue;
+      }
+
+      out[n] = r->ev[r->tail % TRACE_NEVENT];
+      __sync_synchronize();
+      if(r->head - r->tail >= TRACE_NEVENT)
+        continue; // slot may have been rewritten; count it as lost
+      r->tail++;
+      n++;
+    }
+  }
+  return n;
+}
+
+// read() on /dev/trace: return whole events, oldest first per hart.
+// Never blocks; returns 0 when every ring is drained.
+int
+tracedev_read(int user_dst, uint64 dst, int n)
+{
+  struct trace_event buf[8];
+  int done = 0;
+
+  while(n - done >= (int)sizeof(struct trace_event)){
+    int want = (n - done) / sizeof(struct trace_event);
+    if(want > NELEM(buf))
+      want = NELEM(buf);
+
+    acquire(&trace_rdlock);
+    int got = trace_take(buf, want);
+    release(&trace_rdlock);
+
+    if(got == 0)
+      break;
+    if(either_copyout(user_dst, dst + done, buf, got * sizeof(struct trace_event)) < 0)
+      return done > 0 ? done : -1;
+    done += got * sizeof(struct trace_event);
+  }
+  return done;
+}
+
+int
+tracedev_write(int user_src, uint64 src, int n)
+{
+  return -1;
+}
+
+void
+tracedev_register(void)
+{
+  initlock(&trace_rdlock, "trace");
+  devsw[TRACE_DEVICE].read = tracedev_read;
+  devsw[TRACE_DEVICE].write = tracedev_write;
+}
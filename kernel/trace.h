@@ -0,0 +1,25 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Binary event format streamed by /dev/trace.
+// Shared by the kernel, user/tracedump.c and tools/tracedecode.py,
+// so keep the layout fixed (32 bytes, little-endian, no padding).
+
+#define TRACE_NEVENT 512    // events per hart ring (power of two)
+
+// event types
+#define TR_LOST    1   // reader fell behind; arg0 = events dropped
+#define TR_DBG     2   // dbg_record(); arg0 = value
+#define TR_SWITCH  3   // scheduler switched to pid; arg0 = pid
+#define TR_FRAME   4   // animation frame drawn; arg0 = frame number
+
+struct trace_event {
+  uint64 ts;       // r_time() when recorded
+  uint16 type;     // TR_*
+  uint16 cpu;      // hart that recorded the event
+  int    pid;      // current process, 0 if none
+  uint64 arg0;
+  uint64 arg1;
+};
+
+#endif // TRACE_H
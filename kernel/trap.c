@@ -75,11 +75,16 @@ usertrap(void)
   if ((r_sstatus() & SSTATUS_SPP) != 0)
     panic("usertrap: not from user mode");
 
+  // for tlbshootdown().
+  mycpu()->inuser = 0;
+  mycpu()->uentries++;
+
   // Switch to kernel trap handler while in kernel mode
   w_stvec((uint64)kernelvec);
 
   struct proc *p = myproc();
   p->trapframe->epc = r_sepc();
+  fpu_enter(p);
 
   if (r_scause() == 8) {
     // System call
@@ -92,9 +97,13 @@ usertrap(void)
 
   } else if ((which_dev = devintr()) != 0) {
     // device interrupt processed
+  } else if (r_scause() == 15 && cowfault(p->pagetable, r_stval()) != 0) {
+    // store to a page shared copy-on-write by fork
   } else if ((r_scause() == 15 || r_scause() == 13) &&
-             vmfault(p->pagetable, r_stval(), (r_scause() == 13)) == 0) {
+             vmfault(p->pagetable, r_stval(), (r_scause() == 13)) != 0) {
     // Lazy page allocation
+  } else if (r_scause() == 2 && fpu_trap(p)) {
+    // first F/V instruction; now enabled, so retry it
   } else {
     printf("usertrap(): unexpected scause=0x%lx pid=%d\n",
            r_scause(), p->pid);
@@ -107,6 +116,8 @@ usertrap(void)
     kexit(-1);
 
   if (which_dev == 2)  // timer
+    schedtick();
+  else if (which_dev == 3)  // EDF budget or period event
     yield();
 
   prepare_return();
@@ -130,12 +141,21 @@ prepare_return(void)
   p->trapframe->kernel_trap = (uint64)usertrap;
   p->trapframe->kernel_hartid = r_tp();
 
+  // F/V enables and registers for user mode.
+  fpu_restore(p);
+
   unsigned long x = r_sstatus();
   x &= ~SSTATUS_SPP;
   x |= SSTATUS_SPIE;
   w_sstatus(x);
 
   w_sepc(p->trapframe->epc);
+
+  // where uservec and userret find the trapframe.
+  w_sscratch(p->tfva);
+
+  // userret flushes the TLB before user code runs again.
+  mycpu()->inuser = 1;
 }
 
 // -----------------------------------------------------
@@ -165,7 +185,9 @@ kerneltrap(void)
   if (which_dev == 2) {
     anim_tick();
     if (myproc() != 0)
-      yield();
+      schedtick();
+  } else if (which_dev == 3 && myproc() != 0) {
+    yield();
   }
 
   // Restore registers
@@ -176,18 +198,91 @@ kerneltrap(void)
 // -----------------------------------------------------
 // TIMER INTERRUPT
 // -----------------------------------------------------
-void
+static uint64 tickdue[NCPU];   // time of each hart's next scheduling tick
+
+// Returns 2 if this interrupt is a scheduling tick, 3 if it
+// is an EDF budget or period event that should preempt the
+// current process, 1 if it only served the sampling profiler.
+int
 clockintr(void)
 {
-  if (cpuid() == 0) {
-    acquire(&tickslock);
-    ticks++;
-    wakeup(&ticks);
-    release(&tickslock);
+  int id = cpuid();
+  uint64 now = r_time();
+  int tick = 0, resched = 0;
+
+  if (now >= tickdue[id]) {
+    if (id == 0) {
+      acquire(&tickslock);
+      ticks++;
+      release(&tickslock);
+
+      // flush kernel log output printed with locks held.
+      if (klog_pending())
+        uartkick();
+
+      if (ticks % MLFQ_BOOST == 0)
+        mlfq_boost();
+    }
+    tickdue[id] = now + TICKINTERVAL;
+    tick = 1;
+
+    // charge the tick to whatever this hart was running.
+    struct proc *p = mycpu()->proc;
+    if (p)
+      p->ticks++;
   }
 
-  // next timer event (100ms)
-  w_stimecmp(r_time() + 1000000);
+  // next timer event: the next tick (100ms), or the next
+  // profiler sample, EDF event or hrtimer if that comes sooner.
+  uint64 next = tickdue[id];
+  uint64 hr = hrtimer_run(now);
+  if (hr != 0 && hr < next)
+    next = hr;
+  uint64 sample = prof_tick(now);
+  if (sample != 0 && sample < next)
+    next = sample;
+  uint64 edf = edf_clock(now, &resched);
+  if (edf != 0 && edf < next)
+    next = edf;
+  w_stimecmp(next);
+
+  if (tick) {
+    // an EDF event due with the tick: schedtick() yields for it.
+    if (resched)
+      mycpu()->resched = 1;
+    return 2;
+  }
+  return resched ? 3 : 1;
+}
+
+// -----------------------------------------------------
+// INTER-PROCESSOR INTERRUPTS
+// -----------------------------------------------------
+
+// Interrupt hart cpu.  Its mvec (kernelvec.S) forwards the CLINT
+// software interrupt to supervisor mode, where devintr() sees it.
+void
+ipi_send(int cpu)
+{
+  *(volatile uint32 *)CLINT_MSIP(cpu) = 1;
+}
+
+// A supervisor software interrupt: another hart queued work for
+// this one.  An idle hart needs nothing more; wfi has returned and
+// scheduler() will look again.  Returns 3 if the current process
+// should yield (e.g. to an EDF process), 1 otherwise.
+static int
+ipiintr(void)
+{
+  struct cpu *c = mycpu();
+
+  w_sip(r_sip() & ~SIP_SSIP);
+  if (c->resched) {
+    c->resched = 0;
+    if (c->proc)
+      return 3;
+  }
+  return 1;
 }
 
 // -----------------------------------------------------
@@ -215,10 +310,16 @@ devintr(void)
     return 1;
   }
 
-  // Timer interrupt
+  // Timer interrupt; only scheduling ticks count as timer
+  // interrupts for the callers (they yield on 2, or on 3 for
+  // an EDF event or a rescheduling IPI).
   else if (scause == 0x8000000000000005L) {
-    clockintr();
-    return 2;
+    return clockintr();
+  }
+
+  // Software interrupt: an IPI from another hart.
+  else if (scause == 0x8000000000000001L) {
+    return ipiintr();
   }
 
   return 0;
@@ -34,6 +34,7 @@
 #define LSR 5                 // line status register
 #define LSR_RX_READY (1<<0)   // input is waiting to be read from RHR
 #define LSR_TX_IDLE (1<<5)    // THR can accept another character to send
+#define TX_FIFO 16            // transmit FIFO depth; all free when LSR_TX_IDLE
 
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
@@ -98,9 +99,41 @@ uartwrite(char buf[], int n)
   release(&tx_lock);
 }
 
+// send the next kernel log bytes, if the UART is idle.
+// caller holds tx_lock.
+static void
+uartstart(void)
+{
+  char buf[TX_FIFO];
+  int n;
+
+  if(tx_busy)
+    return;
+  if((n = klog_tx(buf, sizeof(buf))) == 0)
+    return;
+  for(int i = 0; i < n; i++)
+    WriteReg(THR, buf[i]);
+  tx_busy = 1;
+}
+
+// start draining the kernel log, if the UART is idle.
+// called by printf(); must not be called with a spinlock held.
+void
+uartkick(void)
+{
+  // racy peek, so printf() usually avoids the lock entirely.
+  // printf() published its message before looking, and uartintr()
+  // clears tx_busy before it pulls, so nothing is stranded.
+  __sync_synchronize();
+  if(tx_busy)
+    return;
+  acquire(&tx_lock);
+  uartstart();
+  release(&tx_lock);
+}
 
 // write a byte to the uart without using
-// interrupts, for use by kernel printf() and
+// interrupts, for use by panic() and
 // to echo characters. it spins waiting for the uart's
 // output register to be empty.
 void
@@ -146,9 +179,11 @@ uartintr(void)
 
   acquire(&tx_lock);
   if(ReadReg(LSR) & LSR_TX_IDLE){
-    // UART finished transmitting; wake up sending thread.
+    // UART finished transmitting; wake up sending thread,
+    // and keep draining the kernel log.
     tx_busy = 0;
     wakeup(&tx_chan);
+    uartstart();
   }
   release(&tx_lock);
 
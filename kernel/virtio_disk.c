@@ -15,6 +15,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "virtio.h"
+#include "iostat.h"
 
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
@@ -48,6 +49,8 @@ static struct disk {
   struct {
     struct buf *b;
     char status;
+    char write;      // for iostat
+    uint64 start;    // r_time() at submit, for iostat
   } info[NUM];
 
   // disk command headers.
@@ -55,6 +58,8 @@ static struct disk {
   struct virtio_blk_req ops[NUM];
   
   struct spinlock vdisk_lock;
+
+  int inflight;    // requests submitted but not yet completed
   
 } disk;
 
@@ -178,7 +183,6 @@ free_desc(int i)
   disk.desc[i].flags = 0;
   disk.desc[i].next = 0;
   disk.free[i] = 1;
-  wakeup(&disk.free[0]);
 }
 
 // free a chain of descriptors.
@@ -194,6 +198,19 @@ free_chain(int i)
     else
       break;
   }
+  // a chain is three descriptors: enough for one waiter.
+  wakeup_one(&disk.free[0]);
+}
+
+// how many descriptors are free?
+static int
+nfree_desc(void)
+{
+  int n = 0;
+
+  for(int i = 0; i < NUM; i++)
+    n += disk.free[i];
+  return n;
 }
 
 // allocate three descriptors (they need not be contiguous).
@@ -231,6 +248,9 @@ virtio_disk_rw(struct buf *b, int write)
     }
     sleep(&disk.free[0], &disk.vdisk_lock);
   }
+  // pass the wakeup on if there is room for another request.
+  if(nfree_desc() >= 3)
+    wakeup_one(&disk.free[0]);
 
   // format the three descriptors.
   // qemu's virtio-blk.c reads them.
@@ -267,6 +287,11 @@ virtio_disk_rw(struct buf *b, int write)
   // record struct buf for virtio_disk_intr().
   b->disk = 1;
   disk.info[idx[0]].b = b;
+  disk.info[idx[0]].write = write;
+
+  disk.inflight++;
+  iostats.depth[disk.inflight < IOSTAT_NDEPTH ? disk.inflight : IOSTAT_NDEPTH-1]++;
+  disk.info[idx[0]].start = r_time();
 
   // tell the device the first index in our chain of descriptors.
   disk.avail->ring[disk.avail->idx % NUM] = idx[0];
@@ -320,6 +345,13 @@ virtio_disk_intr()
     b->disk = 0;   // disk is done with buf
     wakeup(b);
 
+    disk.inflight--;
+    iostats.lat[hist_bucket(r_time() - disk.info[id].start)]++;
+    if(disk.info[id].write)
+      iostats.writes++;
+    else
+      iostats.reads++;
+
     disk.used_idx += 1;
   }
 
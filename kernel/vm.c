@@ -17,6 +17,13 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+uint64 nvmfault;          // pages lazily mapped by vmfault(), all processes
+uint64 ncowcopy;          // pages copied by cowfault(), all processes
+
+// clone()d threads share a page table and may fault on the
+// same page at once; vmfault() and cowfault() map under this lock.
+static struct spinlock faultlock;
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
@@ -35,6 +42,9 @@ kvmmake(void)
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x4000000, PTE_R | PTE_W);
 
+  // CLINT software interrupt registers, for IPIs
+  kvmmap(kpgtbl, CLINT, CLINT, PGSIZE, PTE_R | PTE_W);
+
   // map kernel text executable and read-only.
   kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
 
@@ -45,9 +55,8 @@ kvmmake(void)
   // the highest virtual address in the kernel.
   kvmmap(kpgtbl, TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
 
-  // allocate and map a kernel stack for each process.
-  proc_mapstacks(kpgtbl);
-  
+  // kernel stacks are mapped as processes are created (see stackalloc()).
+
   return kpgtbl;
 }
 
@@ -66,6 +75,7 @@ void
 kvminit(void)
 {
   kernel_pagetable = kvmmake();
+  initlock(&faultlock, "vmfault");
 }
 
 // Switch the current CPU's h/w page table register to
@@ -105,9 +115,8 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
     if(*pte & PTE_V) {
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      if(!alloc || (pagetable = (pde_t*)kzalloc()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -179,10 +188,9 @@ pagetable_t
 uvmcreate()
 {
   pagetable_t pagetable;
-  pagetable = (pagetable_t) kalloc();
+  pagetable = (pagetable_t) kzalloc();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
   return pagetable;
 }
 
@@ -224,12 +232,11 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kzalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
@@ -257,6 +264,43 @@ uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
   return newsz;
 }
 
+// Like uvmdealloc(), for a page table that threads on other harts
+// may be using: the pages are unmapped, tlbshootdown() makes sure
+// no hart still reaches them through its TLB, and only then are
+// they freed.  In between, an unmapped PTE keeps its address with
+// PTE_V clear.  The caller has already lowered every sharer's sz,
+// so vmfault(), which checks sz under faultlock, maps nothing new
+// in the range.  Not covered: a thread in copyin() or copyout() on
+// another hart that looked up a physical address before the shrink
+// may still use it.  Returns the new process size.
+uint64
+uvmshrink(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
+{
+  uint64 a, start, end;
+  pte_t *pte;
+
+  if(newsz >= oldsz)
+    return oldsz;
+
+  start = PGROUNDUP(newsz);
+  end = PGROUNDUP(oldsz);
+  acquire(&faultlock);
+  for(a = start; a < end; a += PGSIZE)
+    if((pte = walk(pagetable, a, 0)) != 0 && (*pte & PTE_V))
+      *pte &= ~PTE_V;
+  release(&faultlock);
+  tlbshootdown(pagetable);
+  acquire(&faultlock);
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walk(pagetable, a, 0)) == 0 || *pte == 0 || (*pte & PTE_V))
+      continue;
+    kfree((void*)PTE2PA(*pte));
+    *pte = 0;
+  }
+  release(&faultlock);
+  return newsz;
+}
+
 // Recursively free page-table pages.
 // All leaf mappings must already have been removed.
 void
@@ -299,23 +343,34 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   pte_t *pte;
   uint64 pa, i;
   uint flags;
-  char *mem;
 
   for(i = 0; i < sz; i += PGSIZE){
     if((pte = walk(old, i, 0)) == 0)
       continue;   // page table entry hasn't been allocated
-    if((*pte & PTE_V) == 0)
+    // share the page; a writable one becomes read-only and
+    // copy-on-write in both, copied by the first store.  Under
+    // faultlock, so that a clone()d thread in cowfault() sees
+    // both the new PTE and the extra reference, or neither.
+    acquire(&faultlock);
+    if((*pte & PTE_V) == 0){
+      release(&faultlock);
       continue;   // physical page hasn't been allocated
+    }
     pa = PTE2PA(*pte);
+    if(*pte & (PTE_W | PTE_COW))
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto err;
-    memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
-      kfree(mem);
+    krefinc((void*)pa);
+    release(&faultlock);
+    if(mappages(new, i, PGSIZE, pa, flags) != 0){
+      kfree((void*)pa);
       goto err;
     }
   }
+  // clone()d threads of old on other harts may still have the
+  // pages writable in their TLBs; this hart flushes its own on
+  // the way back to user space.
+  tlbshootdown(old);
   return 0;
 
  err:
@@ -323,6 +378,55 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   return -1;
 }
 
+// Resolve a store to copy-on-write page va: copy it, or, if no
+// other page table maps it any more, just make it writable.
+// Returns the physical address now mapped writable, or 0 if va
+// is not a copy-on-write page or memory runs out.
+uint64
+cowfault(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  char *mem = 0;
+
+  if(va >= MAXVA)
+    return 0;
+  va = PGROUNDDOWN(va);
+
+  acquire(&faultlock);
+  pte = walk(pagetable, va, 0);
+  if(pte == 0 || (*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U)){
+    release(&faultlock);
+    return 0;
+  }
+  pa = PTE2PA(*pte);
+  if((*pte & PTE_COW) == 0){
+    release(&faultlock);
+    // another thread resolved it first?
+    return (*pte & PTE_W) ? pa : 0;
+  }
+  if(krefcount((void*)pa) > 1){
+    if((mem = kalloc()) == 0){
+      release(&faultlock);
+      return 0;
+    }
+    memmove(mem, (char*)pa, PGSIZE);
+    *pte = PA2PTE(mem) | PTE_FLAGS(*pte);
+    __sync_fetch_and_add(&ncowcopy, 1);
+  }
+  *pte = (*pte & ~PTE_COW) | PTE_W;
+  release(&faultlock);
+
+  if(mem){
+    // sibling threads may still read the old page through their
+    // TLBs; move them to the copy before letting the old one go.
+    tlbshootdown(pagetable);
+    kfree((void*)pa);   // drop our reference to the shared page
+    return (uint64)mem;
+  }
+  return pa;
+}
+
 // mark a PTE invalid for user access.
 // used by exec for the user stack guard page.
 void
@@ -358,8 +462,13 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
     }
 
     pte = walk(pagetable, va0, 0);
+    // give this page table its own copy of a page shared by fork.
+    if(*pte & PTE_COW){
+      if((pa0 = cowfault(pagetable, va0)) == 0)
+        return -1;
+    }
     // forbid copyout over read-only user text pages.
-    if((*pte & PTE_W) == 0)
+    else if((*pte & PTE_W) == 0)
       return -1;
       
     n = PGSIZE - (dstva - va0);
@@ -461,14 +570,31 @@ vmfault(pagetable_t pagetable, uint64 va, int read)
   if(ismapped(pagetable, va)) {
     return 0;
   }
-  mem = (uint64) kalloc();
+  mem = (uint64) kzalloc();
   if(mem == 0)
     return 0;
-  memset((void *) mem, 0, PGSIZE);
+  acquire(&faultlock);
+  if(va >= p->sz) {
+    // a sibling thread shrank the memory meanwhile; see uvmshrink().
+    release(&faultlock);
+    kfree((void *)mem);
+    return 0;
+  }
+  if(ismapped(pagetable, va)) {
+    // another thread got here first.
+    uint64 pa = PTE2PA(*walk(pagetable, va, 0));
+    release(&faultlock);
+    kfree((void *)mem);
+    return pa;
+  }
   if (mappages(p->pagetable, va, PGSIZE, mem, PTE_W|PTE_U|PTE_R) != 0) {
+    release(&faultlock);
     kfree((void *)mem);
     return 0;
   }
+  release(&faultlock);
+  p->nfault++;
+  __sync_fetch_and_add(&nvmfault, 1);
   return mem;
 }
 
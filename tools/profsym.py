@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+# Symbolize xv6 profiler samples into a flat profile or folded stacks.
+#
+# Capture the console output of `prof cmd ...` (e.g. qemu.out) and run
+#
+#   ./tools/profsym.py qemu.out              # flat profile
+#   ./tools/profsym.py --folded qemu.out     # input for flamegraph.pl
+#
+# Kernel pcs are looked up in kernel/kernel.sym, user pcs in
+# user/<name>.sym, both written by the Makefile.
+import argparse, bisect, collections, os, sys
+
+class SymTab:
+    def __init__(self, path):
+        self.addrs, self.names = [], []
+        if not os.path.exists(path):
+            return
+        syms = []
+        for line in open(path):
+            parts = line.split()
+            if len(parts) != 2:
+                continue
+            try:
+                addr = int(parts[0], 16)
+            except ValueError:
+                continue
+            name = parts[1]
+            # skip section, file and local-label symbols
+            if name.startswith('.') or name.endswith('.c') or name.endswith('.S'):
+                continue
+            syms.append((addr, name))
+        syms.sort()
+        self.addrs = [a for a, _ in syms]
+        self.names = [n for _, n in syms]
+
+    def lookup(self, pc):
+        i = bisect.bisect_right(self.addrs, pc) - 1
+        if i < 0:
+            return '0x%x' % pc
+        return self.names[i]
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__)
+    ap.add_argument('file', nargs='?', help='console capture (default stdin)')
+    ap.add_argument('--root', default=os.path.join(os.path.dirname(__file__), '..'),
+                    help='xv6 source tree holding kernel/ and user/')
+    ap.add_argument('--folded', action='store_true',
+                    help='print "proc;symbol count" lines for flamegraph.pl')
+    ap.add_argument('--top', type=int, default=30, help='rows in the flat profile')
+    args = ap.parse_args()
+
+    text = open(args.file, errors='replace') if args.file else sys.stdin
+    kernel = SymTab(os.path.join(args.root, 'kernel', 'kernel.sym'))
+    users = {}
+    flat = collections.Counter()
+    folded = collections.Counter()
+    total = 0
+
+    for line in text:
+        i = line.find('@P ')
+        if i < 0:
+            continue
+        f = line[i+3:].split()
+        if len(f) < 5 or f[0] == 'end':
+            continue
+        cpu, pid, mode, pc, name = f[0], f[1], f[2], int(f[3], 16), f[4]
+        if mode == 'k':
+            sym = '[k] ' + kernel.lookup(pc)
+        else:
+            if name not in users:
+                users[name] = SymTab(os.path.join(args.root, 'user', name + '.sym'))
+            sym = name + ' ' + users[name].lookup(pc)
+        flat[sym] += 1
+        folded[name + ';' + sym.replace(' ', '_')] += 1
+        total += 1
+
+    if total == 0:
+        print('no samples found', file=sys.stderr)
+        return 1
+
+    if args.folded:
+        for stack, n in sorted(folded.items()):
+            print(stack, n)
+        return 0
+
+    print('%d samples' % total)
+    print('%7s %6s  %s' % ('samples', '%', 'symbol'))
+    for sym, n in flat.most_common(args.top):
+        print('%7d %5.1f%%  %s' % (n, 100.0 * n / total, sym))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# Decode xv6 /dev/trace events.
+#
+# Input is either a raw binary dump of /dev/trace, or a console capture
+# (e.g. qemu output) containing the "@T <hex>" lines printed by tracedump.
+#
+#   ./tools/tracedecode.py qemu.out
+#   ./tools/tracedecode.py --hz 10000000 trace.bin
+import argparse, struct, sys
+
+EVENT = struct.Struct('<QHHiQQ')   # struct trace_event in kernel/trace.h
+
+TYPES = {
+    1: 'lost',
+    2: 'dbg',
+    3: 'switch',
+    4: 'frame',
+}
+
+def events_from_text(data):
+    for line in data.decode('utf-8', 'replace').splitlines():
+        i = line.find('@T ')
+        if i < 0:
+            continue
+        word = line[i+3:].strip()
+        if len(word) != 2 * EVENT.size:
+            continue
+        try:
+            yield EVENT.unpack(bytes.fromhex(word))
+        except ValueError:
+            continue
+
+def events_from_binary(data):
+    for off in range(0, len(data) - EVENT.size + 1, EVENT.size):
+        yield EVENT.unpack_from(data, off)
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__)
+    ap.add_argument('file', nargs='?', help='capture or binary dump (default stdin)')
+    ap.add_argument('--hz', type=int, default=10000000,
+                    help='timebase frequency of the time CSR (qemu virt: 10 MHz)')
+    ap.add_argument('--binary', action='store_true', help='input is a raw /dev/trace dump')
+    args = ap.parse_args()
+
+    data = open(args.file, 'rb').read() if args.file else sys.stdin.buffer.read()
+    evs = list(events_from_binary(data) if args.binary else events_from_text(data))
+    if not evs:
+        print('no events found', file=sys.stderr)
+        return 1
+
+    evs.sort(key=lambda e: e[0])
+    t0 = evs[0][0]
+    counts = {}
+    for ts, typ, cpu, pid, a0, a1 in evs:
+        name = TYPES.get(typ, 'type%d' % typ)
+        counts[name] = counts.get(name, 0) + 1
+        us = (ts - t0) * 1000000 // args.hz
+        print('%12d us  cpu%-2d pid %-4d %-8s %d %d' % (us, cpu, pid, name, a0, a1))
+
+    print('# %d events: %s' % (len(evs),
+          ', '.join('%s=%d' % kv for kv in sorted(counts.items()))), file=sys.stderr)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,31 @@
+// user/dmesg.c
+// Print the kernel log history.
+//
+//   dmesg         everything still in the history
+//   dmesg n       only the last n bytes
+#include "kernel/types.h"
+#include "kernel/klog.h"
+#include "user/user.h"
+
+static char buf[KLOG_HISTSZ];
+
+int
+main(int argc, char *argv[])
+{
+  int n = sizeof(buf);
+
+  if (argc > 2) {
+    fprintf(2, "usage: dmesg [bytes]\n");
+    exit(1);
+  }
+  if (argc == 2 && (n = atoi(argv[1])) > sizeof(buf))
+    n = sizeof(buf);
+
+  n = dmesg(buf, n);
+  if (n < 0) {
+    fprintf(2, "dmesg: dmesg() failed\n");
+    exit(1);
+  }
+  write(1, buf, n);
+  exit(0);
+}
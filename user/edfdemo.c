@@ -0,0 +1,71 @@
+// user/edfdemo.c
+// A frame-paced loop under the EDF class: every period it does
+// work_ms of computation, then edfyield()s until the next period.
+// Run it next to grind or usertests to see deadlines hold.
+//
+//   edfdemo [-n] period_ms budget_ms work_ms frames
+//
+// -n runs the same loop as an ordinary process, for comparison.
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+static uint64
+now(void)
+{
+  uint64 t;
+  asm volatile("rdtime %0" : "=r" (t));
+  return t;
+}
+
+#define MS (TIMEBASE / 1000)
+
+int
+main(int argc, char *argv[])
+{
+  int normal = 0;
+
+  if (argc > 1 && strcmp(argv[1], "-n") == 0) {
+    normal = 1;
+    argc--;
+    argv++;
+  }
+  if (argc != 5) {
+    fprintf(2, "usage: edfdemo [-n] period_ms budget_ms work_ms frames\n");
+    exit(1);
+  }
+  int period = atoi(argv[1]), budget = atoi(argv[2]);
+  int work = atoi(argv[3]), frames = atoi(argv[4]);
+
+  if (!normal && edfset(period * 1000, budget * 1000) < 0) {
+    fprintf(2, "edfdemo: edfset(%d ms, %d ms) not admitted\n", period, budget);
+    exit(1);
+  }
+
+  int missed = 0;
+  uint64 deadline = now() + period * MS;
+  for (int f = 0; f < frames; f++) {
+    // work_ms of CPU time, not wall time: preemption stretches it.
+    uint64 spent = 0, t = now();
+    while (spent < work * MS) {
+      uint64 t1 = now();
+      if (t1 - t < MS / 10)     // count only while we were running
+        spent += t1 - t;
+      t = t1;
+    }
+
+    if (normal) {
+      if (now() > deadline)
+        missed++;
+      while (now() < deadline)
+        ;
+      deadline += period * MS;
+    } else {
+      missed += edfyield();
+    }
+  }
+
+  printf("edfdemo: %d of %d frames missed (%s)\n", missed, frames,
+         normal ? "normal" : "edf");
+  exit(0);
+}
@@ -0,0 +1,89 @@
+// user/fbbench.c
+// Time libfb's row primitives, scalar against RVV, on
+// full-screen buffers.
+//
+//   fbbench [iters]
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/hwcap.h"
+#include "user/user.h"
+#include "user/libfb.h"
+
+#define NPIX (FB_WIDTH * FB_HEIGHT)
+
+static unsigned int a[NPIX], b[NPIX];
+
+static uint64
+now(void)
+{
+  uint64 t;
+  asm volatile("rdtime %0" : "=r" (t));
+  return t;
+}
+
+// time CSR units per call, in tenths of a microsecond
+static uint64
+timefill(void (*fill)(unsigned int*, unsigned int, int), int iters)
+{
+  uint64 t0 = now();
+  for (int i = 0; i < iters; i++)
+    fill(a, i, NPIX);
+  return (now() - t0) / iters;
+}
+
+static uint64
+timecopy(void (*copy)(unsigned int*, const unsigned int*, int), int iters)
+{
+  uint64 t0 = now();
+  for (int i = 0; i < iters; i++)
+    copy(b, a, NPIX);
+  return (now() - t0) / iters;
+}
+
+static void
+row(char *name, uint64 scalar, uint64 vec)
+{
+  printf("%s\t%d us\t", name, (int)(scalar / (TIMEBASE / 1000000)));
+  if (vec == 0) {
+    printf("-\n");
+    return;
+  }
+  printf("%d us\t%d.%dx\n", (int)(vec / (TIMEBASE / 1000000)),
+         (int)(scalar / vec), (int)(scalar * 10 / vec % 10));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int iters = argc > 1 ? atoi(argv[1]) : 200;
+  int v = (hwcap() & HWCAP_V) != 0;
+
+  if (iters <= 0) {
+    fprintf(2, "usage: fbbench [iters]\n");
+    exit(1);
+  }
+
+  uint64 fs = timefill(libfb_fill_scalar, iters);
+  uint64 cs = timecopy(libfb_copy_scalar, iters);
+  uint64 fv = v ? timefill(libfb_fill_rvv, iters) : 0;
+  uint64 cv = v ? timecopy(libfb_copy_rvv, iters) : 0;
+
+  // the copies must agree whichever way they were made.
+  if (v) {
+    libfb_fill_scalar(a, 0x123456, NPIX);
+    libfb_copy_rvv(b, a, NPIX);
+    for (int i = 0; i < NPIX; i++) {
+      if (b[i] != 0x123456) {
+        fprintf(2, "fbbench: rvv copy wrong at %d\n", i);
+        exit(1);
+      }
+    }
+  }
+
+  printf("%d pixels, %d iterations%s\n", NPIX, iters,
+         v ? "" : " (no vector extension)");
+  printf("op\tscalar\trvv\tspeedup\n");
+  row("fill", fs, fv);
+  row("copy", cs, cv);
+  exit(0);
+}
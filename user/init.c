@@ -26,6 +26,12 @@ main(void)
   if (open("/dev/fb", O_RDWR) < 0) {
     mknod("/dev/fb", 2, 0);
   }
+  // Event trace stream (/dev/trace -> major 3), read by tracedump
+  int tfd = open("/dev/trace", O_RDONLY);
+  if (tfd < 0)
+    mknod("/dev/trace", 3, 0);
+  else
+    close(tfd);
   dup(0);  // stdout
   dup(0);  // stderr
 
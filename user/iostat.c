@@ -0,0 +1,79 @@
+// user/iostat.c
+// Print buffer cache, disk and log statistics.
+//
+//   iostat            counts since boot (or the last reset)
+//   iostat -r         print, then reset the counters (best-effort)
+//   iostat cmd ...    reset, run cmd, print what it caused
+//
+// The histograms are what NBUF and LOGBLOCKS should be sized from:
+// a low hit ratio asks for a bigger cache, commits that pile up near
+// LOGBLOCKS ask for a bigger log.
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+static struct iostat st;
+
+// time CSR units (10 MHz) to microseconds, rounding up
+static int
+us(uint64 t)
+{
+  return (int)((t + 9) / 10);
+}
+
+// print the non-empty buckets of a histogram as "label count" rows
+static void
+showhist(char *title, uint32 *h, int n, int log2)
+{
+  uint64 total = 0;
+
+  for (int i = 0; i < n; i++)
+    total += h[i];
+  printf("%s\n", title);
+  if (total == 0) {
+    printf("  (none)\n");
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    if (h[i] == 0)
+      continue;
+    if (log2)
+      printf("  <%d\t%d\t%d%%\n", us(2UL << i), h[i], (int)(h[i] * 100 / total));
+    else
+      printf("  %d%s\t%d\t%d%%\n", i, i == n-1 ? "+" : "", h[i],
+             (int)(h[i] * 100 / total));
+  }
+}
+
+static void
+show(int clear)
+{
+  if (iostat(&st, clear ? IO_RESET : 0) < 0) {
+    fprintf(2, "iostat: iostat() failed\n");
+    exit(1);
+  }
+
+  uint64 lookups = st.bhits + st.bmisses;
+  printf("bcache: NBUF %d, %d lookups, %d hits (%d%%), %d misses, %d evictions\n",
+         NBUF, (int)lookups, (int)st.bhits,
+         lookups ? (int)(st.bhits * 100 / lookups) : 0,
+         (int)st.bmisses, (int)st.bevicts);
+  printf("disk: %d reads, %d writes\n", (int)st.reads, (int)st.writes);
+  showhist("disk latency (us)", st.lat, NHIST, 1);
+  showhist("disk queue depth at submit", st.depth, IOSTAT_NDEPTH, 0);
+  printf("log: LOGBLOCKS %d, %d commits\n", LOGBLOCKS, (int)st.commits);
+  showhist("log commit size (blocks)", st.commitsz, IOSTAT_NLOG, 0);
+}
+
+static void
+reset(void)
+{
+  iostat(&st, IO_RESET);
+}
+
+int
+main(int argc, char *argv[])
+{
+  statmain("iostat", argc, argv, show, reset);
+}
@@ -2,6 +2,7 @@
 // User-space framebuffer graphics library
 
 #include "user.h"
+#include "kernel/hwcap.h"
 #include "libfb.h"
 
 // File descriptor for /dev/fb
@@ -10,6 +11,97 @@ static int fb_fd = -1;
 // User-space pixel buffer for batch operations
 static unsigned int fb_buffer[FB_WIDTH * FB_HEIGHT];
 
+// 1 if the vector row primitives can be used; -1 until asked
+static int use_rvv = -1;
+
+void
+libfb_fill_scalar(unsigned int *dst, unsigned int color, int n)
+{
+    for(int i = 0; i < n; i++)
+        dst[i] = color;
+}
+
+void
+libfb_copy_scalar(unsigned int *dst, const unsigned int *src, int n)
+{
+    for(int i = 0; i < n; i++)
+        dst[i] = src[i];
+}
+
+// Strip-mined RVV loops: each pass handles vl pixels, as many as
+// eight vector registers (LMUL=8) hold.  The compiler is not told
+// about v8-v15 because it is not itself targeting V, so it never
+// keeps anything there.  The first vector instruction traps into
+// the kernel, which turns V on for this process.
+void
+libfb_fill_rvv(unsigned int *dst, unsigned int color, int n)
+{
+    unsigned long left = n > 0 ? n : 0, vl;
+
+    if(left == 0)
+        return;
+    asm volatile(".option push\n.option arch, +v\n"
+                 "1: vsetvli %2, %0, e32, m8, ta, ma\n"
+                 "vmv.v.x v8, %3\n"
+                 "vse32.v v8, (%1)\n"
+                 "sub %0, %0, %2\n"
+                 "slli %2, %2, 2\n"
+                 "add %1, %1, %2\n"
+                 "bnez %0, 1b\n"
+                 ".option pop"
+                 : "+r" (left), "+r" (dst), "=&r" (vl)
+                 : "r" (color)
+                 : "memory");
+}
+
+void
+libfb_copy_rvv(unsigned int *dst, const unsigned int *src, int n)
+{
+    unsigned long left = n > 0 ? n : 0, vl;
+
+    if(left == 0)
+        return;
+    asm volatile(".option push\n.option arch, +v\n"
+                 "1: vsetvli %3, %0, e32, m8, ta, ma\n"
+                 "vle32.v v8, (%2)\n"
+                 "vse32.v v8, (%1)\n"
+                 "sub %0, %0, %3\n"
+                 "slli %3, %3, 2\n"
+                 "add %1, %1, %3\n"
+                 "add %2, %2, %3\n"
+                 "bnez %0, 1b\n"
+                 ".option pop"
+                 : "+r" (left), "+r" (dst), "+r" (src), "=&r" (vl)
+                 :
+                 : "memory");
+}
+
+static int
+rvv(void)
+{
+    if(use_rvv < 0)
+        use_rvv = (hwcap() & HWCAP_V) != 0;
+    return use_rvv;
+}
+
+void
+libfb_fill(unsigned int *dst, unsigned int color, int n)
+{
+    if(rvv())
+        libfb_fill_rvv(dst, color, n);
+    else
+        libfb_fill_scalar(dst, color, n);
+}
+
+void
+libfb_copy(unsigned int *dst, const unsigned int *src, int n)
+{
+    if(rvv())
+        libfb_copy_rvv(dst, src, n);
+    else
+        libfb_copy_scalar(dst, src, n);
+}
+
 void
 libfb_init(void)
 {
@@ -36,9 +128,7 @@ libfb_clear(unsigned int color)
     if(fb_fd < 0) return;
     
     // Fill buffer with color
-    for(int i = 0; i < FB_WIDTH * FB_HEIGHT; i++) {
-        fb_buffer[i] = color;
-    }
+    libfb_fill(fb_buffer, color, FB_WIDTH * FB_HEIGHT);
     
     // Write to device
     write(fb_fd, (char*)fb_buffer, FB_WIDTH * FB_HEIGHT * sizeof(unsigned int));
@@ -53,19 +143,53 @@ libfb_draw_pixel(int x, int y, unsigned int color)
     fb_buffer[y * FB_WIDTH + x] = color;
 }
 
+// Clip a w x h block at (x, y) to the screen.  Returns 0 if
+// nothing is left; else sets *sx, *sy to the offset of the
+// visible part within the block.
+static int
+clip(int *x, int *y, int *w, int *h, int *sx, int *sy)
+{
+    *sx = *x < 0 ? -*x : 0;
+    *sy = *y < 0 ? -*y : 0;
+    *x += *sx;
+    *y += *sy;
+    *w -= *sx;
+    *h -= *sy;
+    if(*x + *w > FB_WIDTH)
+        *w = FB_WIDTH - *x;
+    if(*y + *h > FB_HEIGHT)
+        *h = FB_HEIGHT - *y;
+    return *w > 0 && *h > 0;
+}
+
 void
 libfb_draw_rect(int x, int y, int w, int h, unsigned int color)
 {
-    for(int yy = y; yy < y + h; yy++) {
-        for(int xx = x; xx < x + w; xx++) {
-            libfb_draw_pixel(xx, yy, color);
-        }
+    int sx, sy;
+
+    if(clip(&x, &y, &w, &h, &sx, &sy)) {
+        for(int yy = y; yy < y + h; yy++)
+            libfb_fill(&fb_buffer[yy * FB_WIDTH + x], color, w);
     }
     
     // Flush to device after drawing
     write(fb_fd, (char*)fb_buffer, FB_WIDTH * FB_HEIGHT * sizeof(unsigned int));
 }
 
+void
+libfb_blit(int x, int y, int w, int h, const unsigned int *src)
+{
+    int sx, sy, stride = w;
+
+    if(fb_fd < 0) return;
+    if(!clip(&x, &y, &w, &h, &sx, &sy)) return;
+    for(int r = 0; r < h; r++)
+        libfb_copy(&fb_buffer[(y + r) * FB_WIDTH + x],
+                   &src[(sy + r) * stride + sx], w);
+
+    write(fb_fd, (char*)fb_buffer, FB_WIDTH * FB_HEIGHT * sizeof(unsigned int));
+}
+
 void
 libfb_draw_line(int x0, int y0, int x1, int y1, unsigned int color)
 {
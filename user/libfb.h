@@ -32,6 +32,19 @@ void libfb_fill_color(unsigned int color);
 void libfb_test_pattern(void);
 void libfb_draw_gradient(int x, int y, int w, int h);
 
+// Row primitives: fill n pixels with color, copy n pixels.
+// The _rvv versions use the vector extension and need
+// hwcap() & HWCAP_V; the plain ones pick for you.
+void libfb_fill(unsigned int *dst, unsigned int color, int n);
+void libfb_copy(unsigned int *dst, const unsigned int *src, int n);
+void libfb_fill_scalar(unsigned int *dst, unsigned int color, int n);
+void libfb_copy_scalar(unsigned int *dst, const unsigned int *src, int n);
+void libfb_fill_rvv(unsigned int *dst, unsigned int color, int n);
+void libfb_copy_rvv(unsigned int *dst, const unsigned int *src, int n);
+
+// Copy a w x h block of pixels (rows of w) to (x, y), clipped
+void libfb_blit(int x, int y, int w, int h, const unsigned int *src);
+
 // Profiling/timing helpers
 unsigned long libfb_get_ticks(void);
 void libfb_profile_start(void);
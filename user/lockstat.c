@@ -0,0 +1,56 @@
+// user/lockstat.c
+// Print spinlock statistics, most contended first.
+//
+//   lockstat            counts since boot (or the last reset)
+//   lockstat -r         print, then reset the counters (best-effort)
+//   lockstat cmd ...    reset, run cmd, print what it caused
+#include "kernel/types.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+static struct lockstat ls[NLOCKSTAT];
+
+// time CSR units (10 MHz) to microseconds
+#define US(t) ((int)((t) / 10))
+
+static void
+show(int clear)
+{
+  int n = lockstat(ls, NLOCKSTAT, clear ? LS_RESET : 0);
+
+  if (n < 0) {
+    fprintf(2, "lockstat: lockstat() failed\n");
+    exit(1);
+  }
+
+  // insertion sort by contended acquisitions, then spin time
+  for (int i = 1; i < n; i++) {
+    struct lockstat t = ls[i];
+    int j = i;
+    for (; j > 0 && (ls[j-1].contended < t.contended ||
+                     (ls[j-1].contended == t.contended && ls[j-1].spin < t.spin)); j--)
+      ls[j] = ls[j-1];
+    ls[j] = t;
+  }
+
+  printf("%s\t\t%s\t%s\t%s\t%s\t%s\n",
+         "name", "acquire", "contend", "spin-us", "hold-us", "maxhold-us");
+  for (int i = 0; i < n; i++) {
+    printf("%s\t%s%d\t%d\t%d\t%d\t%d\n",
+           ls[i].name, strlen(ls[i].name) < 8 ? "\t" : "",
+           (int)ls[i].acquire, (int)ls[i].contended,
+           US(ls[i].spin), US(ls[i].hold), US(ls[i].maxhold));
+  }
+}
+
+static void
+reset(void)
+{
+  lockstat(ls, 0, LS_RESET);
+}
+
+int
+main(int argc, char *argv[])
+{
+  statmain("lockstat", argc, argv, show, reset);
+}
@@ -0,0 +1,27 @@
+// user/nice.c
+// Run a command at a lower scheduling priority.
+//
+//   nice [-n inc] cmd ...     inc defaults to 10
+#include "kernel/types.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int inc = 10;
+  int i = 1;
+
+  if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+    inc = atoi(argv[2]);
+    i = 3;
+  }
+  if (i >= argc) {
+    fprintf(2, "usage: nice [-n inc] cmd ...\n");
+    exit(1);
+  }
+
+  nice(inc);
+  exec(argv[i], argv + i);
+  fprintf(2, "nice: exec %s failed\n", argv[i]);
+  exit(1);
+}
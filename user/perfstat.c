@@ -0,0 +1,77 @@
+// user/perfstat.c
+// Run a command and report the hardware counters it used.
+//
+//   perfstat cmd ...
+//
+// Counts cover the command and everything it forked and waited
+// for, in kernel and user mode, on whichever harts ran them.
+#include "kernel/types.h"
+#include "kernel/perf.h"
+#include "user/user.h"
+
+// printf() has no 64-bit conversions; format v in decimal
+static char *
+u64str(char buf[21], uint64 v)
+{
+  char *s = buf + 20;
+
+  *--s = 0;
+  do {
+    *--s = '0' + v % 10;
+  } while ((v /= 10) != 0);
+  return s;
+}
+
+// a/b with two decimals, as "x.yy"
+static void
+ratio(char *label, uint64 a, uint64 b)
+{
+  uint64 r = b ? (a * 100 + b / 2) / b : 0;
+  printf("%s%d.%s%d\n", label, (int)(r / 100), r % 100 < 10 ? "0" : "", (int)(r % 100));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct perfcount before, after;
+  uint64 t0;
+
+  if (argc < 2) {
+    fprintf(2, "usage: perfstat cmd ...\n");
+    exit(1);
+  }
+
+  if (getperf(PERF_CHILDREN, &before) < 0) {
+    fprintf(2, "perfstat: getperf() failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+
+  int pid = fork();
+  if (pid < 0) {
+    fprintf(2, "perfstat: fork failed\n");
+    exit(1);
+  }
+  if (pid == 0) {
+    exec(argv[1], argv + 1);
+    fprintf(2, "perfstat: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  int status;
+  wait(&status);
+  int elapsed = uptime() - t0;
+  getperf(PERF_CHILDREN, &after);
+
+  uint64 cycles = after.cycles - before.cycles;
+  uint64 instret = after.instret - before.instret;
+  uint64 time = after.time - before.time;
+
+  printf("\n%s: exit %d\n", argv[1], status);
+  char buf[21];
+  printf("  cycles\t%s\n", u64str(buf, cycles));
+  printf("  instret\t%s\n", u64str(buf, instret));
+  ratio("  IPC\t\t", instret, cycles);
+  printf("  cpu ms\t%d\n", (int)(time / 10000));
+  printf("  wall ticks\t%d\n", elapsed);
+  exit(0);
+}
@@ -0,0 +1,120 @@
+// user/prof.c
+// Sampling profiler front end.
+//
+//   prof [-r hz] cmd [args...]   run cmd with profiling on, then dump
+//   prof dump                    dump the samples of the last run
+//
+// Samples are printed one per line as
+//   @P <cpu> <pid> <k|u> <pc in hex> <name>
+// for tools/profsym.py to symbolize against kernel/kernel.sym and
+// user/<name>.sym.
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define MAXSAMPLES (NCPU * PROF_NSAMPLE)
+
+static char line[80];
+
+static int
+putnum(char *s, uint64 x, int base)
+{
+  static char digits[] = "0123456789abcdef";
+  char tmp[20];
+  int i = 0, n = 0;
+
+  do {
+    tmp[i++] = digits[x % base];
+  } while ((x /= base) != 0);
+  while (--i >= 0)
+    s[n++] = tmp[i];
+  return n;
+}
+
+static int
+dump(void)
+{
+  struct prof_sample *s = malloc(MAXSAMPLES * sizeof(*s));
+  int n, k = 0, u = 0;
+
+  if (s == 0) {
+    fprintf(2, "prof: out of memory\n");
+    return -1;
+  }
+  n = profdump(s, MAXSAMPLES);
+  if (n < 0) {
+    fprintf(2, "prof: profdump failed\n");
+    free(s);
+    return -1;
+  }
+
+  for (int i = 0; i < n; i++) {
+    int m = 0;
+    line[m++] = '@';
+    line[m++] = 'P';
+    line[m++] = ' ';
+    m += putnum(line + m, s[i].cpu, 10);
+    line[m++] = ' ';
+    m += putnum(line + m, s[i].pid, 10);
+    line[m++] = ' ';
+    line[m++] = s[i].user ? 'u' : 'k';
+    line[m++] = ' ';
+    m += putnum(line + m, s[i].pc, 16);
+    line[m++] = ' ';
+    for (int j = 0; j < sizeof(s[i].name) && s[i].name[j]; j++)
+      line[m++] = s[i].name[j];
+    line[m++] = '\n';
+    write(1, line, m);
+    if (s[i].user)
+      u++;
+    else
+      k++;
+  }
+  printf("@P end %d samples (%d kernel, %d user)\n", n, k, u);
+  free(s);
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int hz = 1000;
+  int pid, dropped;
+
+  if (argc == 2 && strcmp(argv[1], "dump") == 0)
+    exit(dump() < 0);
+
+  if (argc >= 3 && strcmp(argv[1], "-r") == 0) {
+    hz = atoi(argv[2]);
+    argv += 2;
+    argc -= 2;
+  }
+  if (argc < 2) {
+    fprintf(2, "usage: prof [-r hz] cmd [args...] | prof dump\n");
+    exit(1);
+  }
+
+  if (profctl(hz) < 0) {
+    fprintf(2, "prof: bad rate %d (max %d)\n", hz, PROF_MAXHZ);
+    exit(1);
+  }
+
+  pid = fork();
+  if (pid < 0) {
+    profctl(0);
+    fprintf(2, "prof: fork failed\n");
+    exit(1);
+  }
+  if (pid == 0) {
+    exec(argv[1], argv + 1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+
+  dropped = profctl(0);
+  if (dropped > 0)
+    printf("prof: %d samples dropped (buffer full)\n", dropped);
+  exit(dump() < 0);
+}
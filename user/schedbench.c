@@ -0,0 +1,98 @@
+// user/schedbench.c
+// Scheduler throughput: pairs of processes ping-pong one byte over
+// pipes, so every round trip is two sleeps and two wakeups.
+//
+//   schedbench [pairs [ticks]]
+//
+// Run with different CPUS= to see how the round-trip rate scales.
+#include "kernel/types.h"
+#include "user/user.h"
+
+// one side of a pair: bounce bytes from in to out until in closes.
+static void
+echo(int in, int out)
+{
+  char c;
+
+  while (read(in, &c, 1) == 1)
+    if (write(out, &c, 1) != 1)
+      break;
+  exit(0);
+}
+
+// the other side: send and await bytes until the deadline, then
+// report the round-trip count on res.
+static void
+ping(int in, int out, int deadline, int res)
+{
+  int n = 0;
+  char c = 'x';
+
+  while (uptime() < deadline) {
+    if (write(out, &c, 1) != 1 || read(in, &c, 1) != 1)
+      break;
+    n++;
+  }
+  close(out);
+  write(res, &n, sizeof(n));
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pairs = argc > 1 ? atoi(argv[1]) : 4;
+  int ticks = argc > 2 ? atoi(argv[2]) : 20;
+  int res[2];
+
+  if (pairs < 1 || ticks < 1) {
+    fprintf(2, "usage: schedbench [pairs [ticks]]\n");
+    exit(1);
+  }
+  if (pipe(res) < 0) {
+    fprintf(2, "schedbench: pipe failed\n");
+    exit(1);
+  }
+
+  // start every pair against the same deadline, one tick ahead so
+  // the forks themselves are not timed.
+  int deadline = uptime() + 1 + ticks;
+  for (int i = 0; i < pairs; i++) {
+    int ab[2], ba[2];
+    if (pipe(ab) < 0 || pipe(ba) < 0) {
+      fprintf(2, "schedbench: pipe failed\n");
+      exit(1);
+    }
+    if (fork() == 0) {
+      close(ab[1]);
+      close(ba[0]);
+      close(res[0]);
+      close(res[1]);
+      echo(ab[0], ba[1]);
+    }
+    if (fork() == 0) {
+      close(ab[0]);
+      close(ba[1]);
+      close(res[0]);
+      while (uptime() < deadline - ticks)
+        pause(1);
+      ping(ba[0], ab[1], deadline, res[1]);
+    }
+    close(ab[0]);
+    close(ab[1]);
+    close(ba[0]);
+    close(ba[1]);
+  }
+  close(res[1]);
+
+  int total = 0, n;
+  while (read(res[0], &n, sizeof(n)) == sizeof(n))
+    total += n;
+  while (wait(0) > 0)
+    ;
+
+  // one tick is 100 ms
+  printf("%d pairs: %d round trips in %d ticks, %d per second\n",
+         pairs, total, ticks, total * 10 / ticks);
+  exit(0);
+}
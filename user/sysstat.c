@@ -0,0 +1,122 @@
+// user/sysstat.c
+// Print per-syscall call counts and latency percentiles.
+//
+//   sysstat            counts since boot (or the last reset)
+//   sysstat -r         print, then reset the counters (best-effort)
+//   sysstat cmd ...    reset, run cmd, print what it caused
+//
+// Percentiles come from log2 histograms, so they are upper bounds
+// rounded up to a power of two.
+#include "kernel/types.h"
+#include "kernel/syscall.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+
+static char *names[SYSSTAT_NCALL] = {
+  [SYS_fork]       "fork",
+  [SYS_exit]       "exit",
+  [SYS_wait]       "wait",
+  [SYS_pipe]       "pipe",
+  [SYS_read]       "read",
+  [SYS_kill]       "kill",
+  [SYS_exec]       "exec",
+  [SYS_fstat]      "fstat",
+  [SYS_chdir]      "chdir",
+  [SYS_dup]        "dup",
+  [SYS_getpid]     "getpid",
+  [SYS_sbrk]       "sbrk",
+  [SYS_pause]      "pause",
+  [SYS_uptime]     "uptime",
+  [SYS_open]       "open",
+  [SYS_write]      "write",
+  [SYS_mknod]      "mknod",
+  [SYS_unlink]     "unlink",
+  [SYS_link]       "link",
+  [SYS_mkdir]      "mkdir",
+  [SYS_close]      "close",
+  [SYS_hello]      "hello",
+  [SYS_kinfo]      "kinfo",
+  [SYS_start_anim] "start_anim",
+  [SYS_stop_anim]  "stop_anim",
+  [SYS_set_speed]  "set_speed",
+  [SYS_view_anim]  "view_anim",
+  [SYS_fb_write]   "fb_write",
+  [SYS_fb_clear]   "fb_clear",
+  [SYS_debuggraph] "debuggraph",
+  [SYS_profctl]    "profctl",
+  [SYS_profdump]   "profdump",
+  [SYS_lockstat]   "lockstat",
+  [SYS_sysstat]    "sysstat",
+  [SYS_procinfo]   "procinfo",
+  [SYS_memstat]    "memstat",
+  [SYS_iostat]     "iostat",
+  [SYS_dmesg]      "dmesg",
+  [SYS_getperf]    "getperf",
+  [SYS_nice]       "nice",
+  [SYS_setaffinity] "setaffinity",
+  [SYS_getaffinity] "getaffinity",
+  [SYS_edfset]     "edfset",
+  [SYS_edfyield]   "edfyield",
+  [SYS_clone]      "clone",
+  [SYS_join]       "join",
+  [SYS_nanosleep]  "nanosleep",
+  [SYS_hwcap]      "hwcap",
+};
+
+static struct sysstat ss[SYSSTAT_NCALL];
+
+// time CSR units (10 MHz) to microseconds, rounding up
+static int
+us(uint64 t)
+{
+  return (int)((t + 9) / 10);
+}
+
+// upper bound of the bucket holding the pct'th percentile
+static uint64
+percentile(struct sysstat *s, int pct)
+{
+  uint64 want = (s->count * pct + 99) / 100;
+  uint64 seen = 0;
+
+  for (int b = 0; b < NHIST; b++) {
+    seen += s->hist[b];
+    if (seen >= want)
+      return 2UL << b;
+  }
+  return 2UL << (NHIST - 1);
+}
+
+static void
+show(int clear)
+{
+  int n = sysstat(ss, SYSSTAT_NCALL, clear ? SS_RESET : 0);
+
+  if (n < 0) {
+    fprintf(2, "sysstat: sysstat() failed\n");
+    exit(1);
+  }
+
+  printf("syscall\t\tcalls\tavg-us\tp50-us\tp99-us\n");
+  for (int i = 0; i < n; i++) {
+    struct sysstat *s = &ss[i];
+    if (s->count == 0)
+      continue;
+    char *name = names[i] ? names[i] : "?";
+    printf("%s\t%s%d\t%d\t%d\t%d\n", name, strlen(name) < 8 ? "\t" : "",
+           (int)s->count, us(s->total / s->count),
+           us(percentile(s, 50)), us(percentile(s, 99)));
+  }
+}
+
+static void
+reset(void)
+{
+  sysstat(ss, 0, SS_RESET);
+}
+
+int
+main(int argc, char *argv[])
+{
+  statmain("sysstat", argc, argv, show, reset);
+}
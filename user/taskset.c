@@ -0,0 +1,69 @@
+// user/taskset.c
+// Get or set CPU affinity.  Masks are hex, bit i for hart i.
+//
+//   taskset mask cmd ...     run cmd on the harts in mask
+//   taskset -p pid           print pid's mask
+//   taskset -p mask pid      set pid's mask
+#include "kernel/types.h"
+#include "user/user.h"
+
+static int
+hex(char *s)
+{
+  int v = 0;
+
+  if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+    s += 2;
+  for (; *s; s++) {
+    if (*s >= '0' && *s <= '9')
+      v = v * 16 + *s - '0';
+    else if (*s >= 'a' && *s <= 'f')
+      v = v * 16 + *s - 'a' + 10;
+    else if (*s >= 'A' && *s <= 'F')
+      v = v * 16 + *s - 'A' + 10;
+    else
+      return -1;
+  }
+  return v;
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: taskset mask cmd ... | taskset -p [mask] pid\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mask;
+
+  if (argc == 3 && strcmp(argv[1], "-p") == 0) {
+    if ((mask = getaffinity(atoi(argv[2]))) < 0) {
+      fprintf(2, "taskset: no process %s\n", argv[2]);
+      exit(1);
+    }
+    printf("pid %s: mask %x\n", argv[2], mask);
+    exit(0);
+  }
+  if (argc == 4 && strcmp(argv[1], "-p") == 0) {
+    if ((mask = hex(argv[2])) <= 0)
+      usage();
+    if (setaffinity(atoi(argv[3]), mask) < 0) {
+      fprintf(2, "taskset: cannot set %s to %s\n", argv[3], argv[2]);
+      exit(1);
+    }
+    exit(0);
+  }
+  if (argc < 3 || (mask = hex(argv[1])) <= 0)
+    usage();
+
+  if (setaffinity(0, mask) < 0) {
+    fprintf(2, "taskset: no running hart in mask %s\n", argv[1]);
+    exit(1);
+  }
+  exec(argv[2], argv + 2);
+  fprintf(2, "taskset: exec %s failed\n", argv[2]);
+  exit(1);
+}
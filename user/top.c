@@ -0,0 +1,187 @@
+// user/top.c
+// Refreshing process monitor built on procinfo().
+//
+//   top [-d ticks] [-n count]
+//
+// Each refresh is one procinfo() and one memstat() call plus one
+// write() of the whole screen, so top itself barely shows up in its
+// own listing.
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/procinfo.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+static struct procinfo cur[NPROC], prev[NPROC];
+static int ncur, nprev;
+static struct memstat mcur, mprev;
+
+static char *states[] = {
+  [PI_UNUSED]   "unused",
+  [PI_USED]     "used",
+  [PI_SLEEPING] "sleep",
+  [PI_RUNNABLE] "runble",
+  [PI_RUNNING]  "run",
+  [PI_ZOMBIE]   "zombie",
+};
+
+// output buffer: one write() per screen
+static char out[4096];
+static int nout;
+
+static void
+outs(char *s, int width)
+{
+  int n = strlen(s);
+  for (int i = 0; i < n && nout < sizeof(out); i++)
+    out[nout++] = s[i];
+  for (; n < width && nout < sizeof(out); n++)
+    out[nout++] = ' ';
+}
+
+static void
+outn(uint64 x, int width)
+{
+  char tmp[24];
+  int i = sizeof(tmp) - 1;
+
+  tmp[i] = 0;
+  do {
+    tmp[--i] = '0' + x % 10;
+  } while ((x /= 10) != 0);
+  for (int n = sizeof(tmp) - 1 - i; n < width && nout < sizeof(out); n++)
+    out[nout++] = ' ';
+  outs(tmp + i, 0);
+}
+
+static struct procinfo *
+lookup(int pid)
+{
+  for (int i = 0; i < nprev; i++)
+    if (prev[i].pid == pid)
+      return &prev[i];
+  return 0;
+}
+
+// events per second between two refreshes wall time units apart
+static uint64
+rate(uint64 now, uint64 then, uint64 wall)
+{
+  if (wall == 0 || now < then)
+    return 0;
+  return (now - then) * TIMEBASE / wall;
+}
+
+static void
+refresh(uint64 wall)
+{
+  nout = 0;
+  outs("\033[H\033[J", 0);    // home, clear screen
+
+  outs("Mem: ", 0);
+  outn(mcur.free * 4, 0);
+  outs(" KB free of ", 0);
+  outn(mcur.total * 4, 0);
+  outs(", peak used ", 0);
+  outn((mcur.total - mcur.minfree) * 4, 0);
+  outs(" KB, alloc/s ", 0);
+  outn(rate(mcur.allocs, mprev.allocs, wall), 0);
+  outs(", free/s ", 0);
+  outn(rate(mcur.frees, mprev.frees, wall), 0);
+  outs(", faults/s ", 0);
+  outn(rate(mcur.faults, mprev.faults, wall), 0);
+  outs(", cow copies/s ", 0);
+  outn(rate(mcur.cowcopies, mprev.cowcopies, wall), 0);
+  outs(", zeroed ", 0);
+  outn(mcur.zeroed * 4, 0);
+  outs(" KB", 0);
+  outs(", failed allocs ", 0);
+  outn(mcur.fails, 0);
+  outs("\n", 0);
+
+  // buddy free blocks by size, for fragmentation.
+  outs("Free blocks (KB:count):", 0);
+  for (int i = 0; i < MEMSTAT_NORDER; i++) {
+    if (mcur.nfree[i] == 0)
+      continue;
+    outs(" ", 0);
+    outn(4 << i, 0);
+    outs(":", 0);
+    outn(mcur.nfree[i], 0);
+  }
+  outs(", failed multi-page allocs ", 0);
+  outn(mcur.bigfails, 0);
+  outs("\n\n", 0);
+
+  outs("PID   PPID  STATE   CPU PRI NI  MEM(KB)  TIME(ms)  %CPU  SWITCH  FAULTS  NAME\n", 0);
+
+  for (int i = 0; i < ncur; i++) {
+    struct procinfo *p = &cur[i];
+    struct procinfo *o = lookup(p->pid);
+    uint64 pct = 0;
+
+    if (o && wall > 0 && p->rtime >= o->rtime)
+      pct = (p->rtime - o->rtime) * 100 / wall;
+
+    outn(p->pid, 4);
+    outn(p->ppid, 6);
+    outs("  ", 0);
+    outs(p->state >= 0 && p->state <= PI_ZOMBIE ? states[p->state] : "?", 7);
+    if (p->cpu >= 0)
+      outn(p->cpu, 4);
+    else
+      outs("   -", 0);
+    outn(p->level, 4);
+    outn(p->nice, 3);
+    outn(p->sz / 1024, 9);
+    outn(p->rtime / (TIMEBASE / 1000), 10);
+    outn(pct, 6);
+    outn(p->nswitch, 8);
+    outn(p->nfault, 8);
+    outs("  ", 0);
+    outs(p->name, 0);
+    outs("\n", 0);
+  }
+  write(1, out, nout);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int delay = 10, count = -1;
+  int t0, t1;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-d") == 0)
+      delay = atoi(argv[i+1]);
+    else if (strcmp(argv[i], "-n") == 0)
+      count = atoi(argv[i+1]);
+    else {
+      fprintf(2, "usage: top [-d ticks] [-n count]\n");
+      exit(1);
+    }
+  }
+  if (delay < 1)
+    delay = 1;
+
+  t0 = uptime();
+  memstat(&mprev);
+  while (count != 0) {
+    if ((ncur = procinfo(cur, NPROC)) < 0 || memstat(&mcur) < 0) {
+      fprintf(2, "top: procinfo failed\n");
+      exit(1);
+    }
+    t1 = uptime();
+    refresh((uint64)(t1 - t0) * TICKINTERVAL);
+
+    memmove(prev, cur, ncur * sizeof(cur[0]));
+    nprev = ncur;
+    mprev = mcur;
+    t0 = t1;
+    if (count > 0)
+      count--;
+    if (count != 0)
+      pause(delay);
+  }
+  exit(0);
+}
@@ -0,0 +1,50 @@
+// user/tracedump.c
+// Drain /dev/trace and print each event as a hex line:
+//   @T <64 hex digits>
+// tools/tracedecode.py turns a captured console log back into events.
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+static struct trace_event ev[32];
+static char line[3 + 2 * sizeof(struct trace_event) + 1];
+
+static void
+hexline(struct trace_event *e)
+{
+  static char hex[] = "0123456789abcdef";
+  uchar *b = (uchar *)e;
+  int n = 0;
+
+  line[n++] = '@';
+  line[n++] = 'T';
+  line[n++] = ' ';
+  for (int i = 0; i < sizeof(*e); i++) {
+    line[n++] = hex[b[i] >> 4];
+    line[n++] = hex[b[i] & 0xf];
+  }
+  line[n++] = '\n';
+  write(1, line, n);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, n, total = 0;
+
+  if ((fd = open("/dev/trace", O_RDONLY)) < 0) {
+    fprintf(2, "tracedump: cannot open /dev/trace\n");
+    exit(1);
+  }
+
+  while ((n = read(fd, ev, sizeof(ev))) > 0) {
+    for (int i = 0; i < n / sizeof(struct trace_event); i++)
+      hexline(&ev[i]);
+    total += n / sizeof(struct trace_event);
+  }
+  close(fd);
+
+  printf("@T end %d events\n", total);
+  exit(0);
+}
@@ -149,3 +149,42 @@ sbrklazy(int n)
     return sys_sbrk(n, SBRK_LAZY);
 }
 
+
+// ------------------------------
+// statistics tools (lockstat, sysstat, iostat)
+// ------------------------------
+
+// main() of a statistics tool:
+//   tool            show(0): counts since boot (or the last reset)
+//   tool -r         show(1): print, then reset the counters
+//   tool cmd ...    reset(), run cmd, show(0) what it caused
+// The counters are per hart and reset without stopping the harts
+// updating them, so a reset is best-effort: a few counts from
+// just before it may survive.
+void
+statmain(char *tool, int argc, char *argv[], void (*show)(int), void (*reset)(void))
+{
+    if (argc == 1) {
+        show(0);
+        exit(0);
+    }
+    if (argc == 2 && strcmp(argv[1], "-r") == 0) {
+        show(1);
+        exit(0);
+    }
+
+    reset();
+    int pid = fork();
+    if (pid < 0) {
+        fprintf(2, "%s: fork failed\n", tool);
+        exit(1);
+    }
+    if (pid == 0) {
+        exec(argv[1], argv + 1);
+        fprintf(2, "%s: exec %s failed\n", tool, argv[1]);
+        exit(1);
+    }
+    wait(0);
+    show(0);
+    exit(0);
+}
@@ -50,6 +50,7 @@ void *memmove(void*, const void*, int);
 char* strchr(const char*, char);
 int strcmp(const char*, const char*);
 char* gets(char*, int);
+void statmain(char*, int, char**, void (*)(int), void (*)(void)) __attribute__((noreturn));
 
 /* size/type-safe wrappers */
 uint strlen(const char*);
@@ -74,6 +75,49 @@ int view_anim(void);
 // Framebuffer user APIs
 int fb_write(int x, int y, uint32 color);
 int fb_clear(uint32 color);
+/* dump the kernel's dbg_record() samples to the console */
+int debuggraph(void);
+/* sampling profiler: profctl(hz) starts (0 stops), profdump copies samples */
+struct prof_sample;
+int profctl(int hz);
+int profdump(struct prof_sample *buf, int max);
+/* per-lock-name spinlock statistics (flags: LS_RESET) */
+struct lockstat;
+int lockstat(struct lockstat *buf, int max, int flags);
+/* per-syscall latency histograms, indexed by SYS_* (flags: SS_RESET) */
+struct sysstat;
+int sysstat(struct sysstat *buf, int max, int flags);
+/* snapshot of the process table; returns number of entries */
+struct procinfo;
+int procinfo(struct procinfo *buf, int max);
+/* physical memory and page-fault counters */
+struct memstat;
+int memstat(struct memstat *ms);
+/* buffer cache, disk and log statistics (flags: IO_RESET) */
+struct iostat;
+int iostat(struct iostat *st, int flags);
+/* copy the most recent n bytes of the kernel log */
+int dmesg(char *buf, int n);
+/* cycle/instret/time totals for self or reaped children */
+struct perfcount;
+int getperf(int who, struct perfcount *pc);
+/* add inc to the scheduling nice value (0..19); returns the new value */
+int nice(int inc);
+/* CPU affinity: bit i of mask allows hart i; pid 0 is the caller */
+int setaffinity(int pid, int mask);
+int getaffinity(int pid);
+/* EDF real-time class: budget_us of CPU every period_us; period 0 leaves it */
+int edfset(int period_us, int budget_us);
+/* done for this period; returns 1 if the deadline was missed */
+int edfyield(void);
+/* thread sharing this process's memory, running fn(arg) on stack
+   (its top); fn must exit().  join() reaps one, like wait(). */
+int clone(void (*fn)(void*), void *arg, void *stack);
+int join(int*);
+/* sleep at least ns nanoseconds (time CSR resolution); -1 if killed */
+int nanosleep(uint64 ns);
+/* HWCAP_* bits (kernel/hwcap.h): F, D and V usable in user mode */
+int hwcap(void);
 /* deprecated/not needed for this change: no kernel headers beyond above */
 /* simple helpers / demos */
 int printf(const char*, ...);
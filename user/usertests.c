@@ -788,6 +788,226 @@ pipe1(char *s)
   }
 }
 
+// several readers and writers on one pipe: wakeups are handed from
+// one sleeper to the next, so none may be left asleep with data
+// (or room) available, and no byte may be lost.
+void
+pipemulti(char *s)
+{
+  int fds[2], res[2], xstatus;
+  enum { NW=4, NR=3, SZ=2000 };
+
+  if(pipe(fds) != 0 || pipe(res) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < NW; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("%s: fork() failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(fds[0]);
+      for(int n = 0; n < SZ; n += 100){
+        memset(buf, 'a' + i, 100);
+        if(write(fds[1], buf, 100) != 100){
+          printf("%s: write failed\n", s);
+          exit(1);
+        }
+      }
+      exit(0);
+    }
+  }
+  for(int i = 0; i < NR; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("%s: fork() failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      int total = 0, n;
+      char c[7];
+      close(fds[1]);
+      while((n = read(fds[0], c, sizeof(c))) > 0)
+        total += n;
+      write(res[1], &total, sizeof(total));
+      exit(0);
+    }
+  }
+  close(fds[0]);
+  close(fds[1]);
+  close(res[1]);
+
+  int total = 0, n;
+  while(read(res[0], &n, sizeof(n)) == sizeof(n))
+    total += n;
+  close(res[0]);
+  for(int i = 0; i < NW + NR; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(xstatus);
+  }
+  if(total != NW * SZ){
+    printf("%s: read %d bytes, wanted %d\n", s, total, NW * SZ);
+    exit(1);
+  }
+}
+
+// threads from clone() share memory: each sums into its own
+// slot of a global, one grows the heap, and the main thread
+// sees all of it after join().
+static volatile int clonesum[4];
+static char * volatile clonebrk;
+
+static void
+clonework(void *arg)
+{
+  int i = (int)(uint64)arg;
+
+  for(int n = 1; n <= 1000; n++)
+    clonesum[i] += n;
+  if(i == 0){
+    char *p = sbrk(PGSIZE);
+    if(p == (char*)-1)
+      exit(1);
+    p[0] = 'x';
+    clonebrk = p;
+  }
+  exit(i);
+}
+
+void
+clonetest(char *s)
+{
+  enum { NT=4 };
+  char *stacks[NT];
+  int pid, xstatus, seen = 0;
+
+  for(int i = 0; i < NT; i++){
+    clonesum[i] = 0;
+    stacks[i] = malloc(4096);
+    if(stacks[i] == 0){
+      printf("%s: malloc failed\n", s);
+      exit(1);
+    }
+    if(clone(clonework, (void*)(uint64)i, stacks[i] + 4096) < 0){
+      printf("%s: clone failed\n", s);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < NT; i++){
+    if((pid = join(&xstatus)) < 0){
+      printf("%s: join failed\n", s);
+      exit(1);
+    }
+    seen |= 1 << xstatus;
+  }
+  if(join(0) != -1){
+    printf("%s: join with no threads left succeeded\n", s);
+    exit(1);
+  }
+  if(seen != (1 << NT) - 1){
+    printf("%s: wrong thread exit statuses %x\n", s, seen);
+    exit(1);
+  }
+  for(int i = 0; i < NT; i++){
+    if(clonesum[i] != 500500){
+      printf("%s: thread %d sum %d\n", s, i, clonesum[i]);
+      exit(1);
+    }
+  }
+  if(clonebrk == 0 || clonebrk[0] != 'x'){
+    printf("%s: heap grown by a thread not visible\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < NT; i++)
+    free(stacks[i]);
+}
+
+// fork shares pages copy-on-write: a store by either side,
+// or a copyout() into the page by the kernel, must not be seen
+// by the other.
+void
+cowtest(char *s)
+{
+  enum { N=64*PGSIZE };
+  int fds[2], xstatus;
+  char *p = sbrk(N);
+
+  if(p == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < N; i += PGSIZE)
+    p[i] = i / PGSIZE;
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(int c = 0; c < 3; c++){
+    int pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      for(int i = 0; i < N; i += PGSIZE){
+        if(p[i] != (char)(i / PGSIZE))
+          exit(1);
+        p[i] = 'c' + c;
+      }
+      // read() copies out into a page still shared with the parent.
+      if(read(fds[0], p + PGSIZE + 1, 1) != 1 || p[PGSIZE + 1] != 'x')
+        exit(2);
+      exit(0);
+    }
+  }
+  if(write(fds[1], "xxx", 3) != 3){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  for(int c = 0; c < 3; c++){
+    wait(&xstatus);
+    if(xstatus != 0){
+      printf("%s: child failed with %d\n", s, xstatus);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < N; i += PGSIZE){
+    if(p[i] != (char)(i / PGSIZE) || (i == PGSIZE && p[i+1] == 'x')){
+      printf("%s: parent saw a child's write at %d\n", s, i);
+      exit(1);
+    }
+  }
+  close(fds[0]);
+  close(fds[1]);
+  sbrk(-N);
+}
+
+// nanosleep() sleeps at least as long as asked.
+void
+nanosleeptest(char *s)
+{
+  int t0 = uptime();
+  if(nanosleep(250000000) < 0){
+    printf("%s: nanosleep failed\n", s);
+    exit(1);
+  }
+  // 250 ms spans at least two 100 ms ticks.
+  if(uptime() - t0 < 2){
+    printf("%s: woke after %d ticks\n", s, uptime() - t0);
+    exit(1);
+  }
+
+  // deadlines so near that the timer fires as it is armed.
+  for(int i = 0; i < 1000; i++){
+    if(nanosleep(i % 2 ? 1 : 100) < 0){
+      printf("%s: short nanosleep failed\n", s);
+      exit(1);
+    }
+  }
+}
 
 // test if child is killed (status = -1)
 void
@@ -2713,7 +2933,7 @@ lazy_sbrk(char *s)
     p = sbrklazy(0);
   }
 
-  int n = TRAPFRAME-PGSIZE-(uint64)p;
+  int n = USERTOP-PGSIZE-(uint64)p;
 
   char *p1 = sbrklazy(n);
   if (p1 < 0 || p1 != p) {
@@ -2722,8 +2942,8 @@ lazy_sbrk(char *s)
   }
 
   p = sbrk(PGSIZE);
-  if (p < 0 || (uint64)p != TRAPFRAME-PGSIZE) {
-    printf("sbrk(%d) returned %p, not expected TRAPFRAME-PGSIZE\n", PGSIZE, p);
+  if (p < 0 || (uint64)p != USERTOP-PGSIZE) {
+    printf("sbrk(%d) returned %p, not expected USERTOP-PGSIZE\n", PGSIZE, p);
     exit(1);
   }
 
@@ -2771,6 +2991,10 @@ struct test {
   {dirtest, "dirtest"},
   {exectest, "exectest"},
   {pipe1, "pipe1"},
+  {pipemulti, "pipemulti"},
+  {clonetest, "clonetest"},
+  {nanosleeptest, "nanosleeptest"},
+  {cowtest, "cowtest"},
   {killstatus, "killstatus"},
   {preempt, "preempt"},
   {exitwait, "exitwait"},
@@ -51,4 +51,23 @@ entry("set_speed");
 entry("view_anim");
 entry("fb_write");
 entry("fb_clear");
+entry("debuggraph");
+entry("profctl");
+entry("profdump");
+entry("lockstat");
+entry("sysstat");
+entry("procinfo");
+entry("memstat");
+entry("iostat");
+entry("dmesg");
+entry("getperf");
+entry("nice");
+entry("setaffinity");
+entry("getaffinity");
+entry("edfset");
+entry("edfyield");
+entry("clone");
+entry("join");
+entry("nanosleep");
+entry("hwcap");
 